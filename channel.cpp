@@ -0,0 +1,217 @@
+/***********************************************************/
+/*              channel class implementation               */
+/***********************************************************/
+
+#include "channel.h"
+
+#include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static_assert(sizeof(channel::request) == 256, "request slots have to stay 256 bytes");
+static_assert(sizeof(channel::response) == 24, "response slots have to stay 24 bytes");
+static_assert(atomic<uint32_t>::is_always_lock_free, "futexes need plain 32 bit words");
+
+static const unsigned int maximumSpin = 1 << 16;
+static const unsigned int minimumSpin = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 64 : 0; //spinning on a single cpu only delays the other side
+
+static inline void relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+channel::channel() : p_segment(0), p_deadline(0), p_owner(false), p_spin(minimumSpin ? 1024 : 0), p_requestTail(0), p_responseHead(0) {
+}
+
+channel::~channel() {
+  close();
+}
+
+//create the segment name (e.g. "/calc") for a consumer, an old segment of that name is reset
+bool channel::create(const string& name) {
+  close();
+  int fd = shm_open(name.c_str(),O_RDWR|O_CREAT,0600);
+  if( fd < 0 || ftruncate(fd,0) != 0 || ftruncate(fd,sizeof(segment)) != 0 ) {
+    if( fd >= 0 )
+      ::close(fd);
+    p_errorstring = "unable to create shared memory "+name;
+    return false;
+  }
+  if( !map(name,fd) )
+    return false;
+  p_owner = true;
+  memcpy(p_segment->magic,"CALC",4);
+  p_segment->version = version;
+  p_segment->slots = capacity;
+  p_segment->ready.store(1);
+  return true;
+}
+
+//attach a producer to the segment name created by a consumer
+bool channel::attach(const string& name) {
+  close();
+  int fd = shm_open(name.c_str(),O_RDWR,0);
+  struct stat st;
+  if( fd < 0 || fstat(fd,&st) != 0 || st.st_size != (off_t)sizeof(segment) ) {
+    if( fd >= 0 )
+      ::close(fd);
+    p_errorstring = "no calculate channel at "+name;
+    return false;
+  }
+  if( !map(name,fd) )
+    return false;
+  if( !p_segment->ready.load() || memcmp(p_segment->magic,"CALC",4) != 0 || p_segment->version != version || p_segment->slots != capacity ) {
+    close();
+    p_errorstring = "incompatible calculate channel at "+name;
+    return false;
+  }
+  p_requestTail = p_segment->requests.tail.value.load();
+  p_responseHead = p_segment->responses.head.value.load();
+  return true;
+}
+
+bool channel::map(const string& name, int fd) {
+  void *data = mmap(0,sizeof(segment),PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+  ::close(fd);
+  if( data == MAP_FAILED ) {
+    p_errorstring = "unable to map shared memory "+name;
+    return false;
+  }
+  p_segment = (segment*)data;
+  p_name = name;
+  return true;
+}
+
+void channel::close() {
+  if( p_segment ) {
+    munmap(p_segment,sizeof(segment));
+    if( p_owner )
+      shm_unlink(p_name.c_str());
+  }
+  p_segment = 0;
+  p_owner = false;
+  p_requestTail = 0;
+  p_responseHead = 0;
+}
+
+void channel::setDeadline(const deadline *limit) {
+  p_deadline = limit;
+}
+
+bool channel::cancelled() const {
+  return p_deadline && p_deadline->cancelled();
+}
+
+string channel::getError() {
+  return p_errorstring;
+}
+
+bool channel::send(const request& r) {
+  ring &q = p_segment->requests;
+  uint32_t head = q.head.value.load(memory_order_relaxed), tail = q.tail.value.load(memory_order_acquire);
+  while( head-tail == capacity ) {
+    if( p_segment->closed.load(memory_order_relaxed) || cancelled() )
+      return false;
+    tail = wait(q.tail,tail);
+  }
+  p_segment->requestSlots[head%capacity] = r;
+  publish(q.head,head+1);
+  return true;
+}
+
+bool channel::receive(response& r) {
+  ring &q = p_segment->responses;
+  uint32_t tail = q.tail.value.load(memory_order_relaxed), head = q.head.value.load(memory_order_acquire);
+  while( head == tail ) {
+    if( p_segment->closed.load(memory_order_relaxed) || cancelled() )
+      return false;
+    head = wait(q.head,head);
+  }
+  r = p_segment->responseSlots[tail%capacity];
+  publish(q.tail,tail+1);
+  return true;
+}
+
+void channel::shutdown() {
+  p_segment->closed.store(1);
+  publish(p_segment->requests.head,p_segment->requests.head.value.load());
+}
+
+uint32_t channel::pending() {
+  ring &q = p_segment->requests;
+  uint32_t head = q.head.value.load(memory_order_acquire);
+  while( head == p_requestTail ) {
+    if( cancelled() )
+      return 0;
+    if( p_segment->closed.load() ) {
+      head = q.head.value.load(memory_order_acquire); //requests sent before shutdown() still get answered
+      if( head == p_requestTail )
+        return 0;
+      break;
+    }
+    head = wait(q.head,head);
+  }
+  return head-p_requestTail;
+}
+
+const channel::request& channel::next() const {
+  return p_segment->requestSlots[p_requestTail%capacity];
+}
+
+void channel::respond(const response& r) {
+  ring &q = p_segment->responses;
+  uint32_t tail = q.tail.value.load(memory_order_acquire);
+  while( p_responseHead-tail == capacity ) { //only if the producer breaks the rule on outstanding requests
+    if( cancelled() )
+      return;
+    publish(q.head,p_responseHead);
+    tail = wait(q.tail,tail);
+  }
+  p_segment->responseSlots[p_responseHead%capacity] = r;
+  p_responseHead++;
+  p_requestTail++;
+}
+
+//publish all answers given since the last commit and free their request slots
+void channel::commit() {
+  publish(p_segment->responses.head,p_responseHead);
+  publish(p_segment->requests.tail,p_requestTail);
+}
+
+//wait until c differs from old (or the channel gets closed or cancelled), returns the new value.
+//Spinning is cheap if the other side answers quickly; if it didn't, the next waits spin shorter and sleep earlier
+uint32_t channel::wait(counter& c, uint32_t old) {
+  uint32_t value;
+  for(unsigned int spin = 0; spin < p_spin; spin++) {
+    value = c.value.load(memory_order_acquire);
+    if( value != old ) {
+      if( p_spin < maximumSpin && minimumSpin )
+        p_spin *= 2;
+      return value;
+    }
+    relax();
+  }
+  if( p_spin > minimumSpin )
+    p_spin /= 2;
+  //sleepers is raised before the value is checked again and publish() stores the value before checking sleepers,
+  //so either we see the new value or publish() sees us sleeping. The timeout covers close() racing with going to sleep,
+  //and cancellation, which nobody publishes
+  struct timespec timeout = { 0, 100000000 };
+  c.sleepers.fetch_add(1);
+  while( (value = c.value.load()) == old && !p_segment->closed.load() && !cancelled() )
+    syscall(SYS_futex,&c.value,FUTEX_WAIT,old,&timeout,0,0);
+  c.sleepers.fetch_sub(1);
+  return value;
+}
+
+void channel::publish(counter& c, uint32_t value) {
+  c.value.store(value);
+  if( c.sleepers.load() )
+    syscall(SYS_futex,&c.value,FUTEX_WAKE,INT_MAX,0,0,0);
+}
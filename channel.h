@@ -0,0 +1,109 @@
+/***********************************************************/
+/*                    channel class                        */
+/* Shared memory front end for producers on the same host. */
+/* A POSIX shared memory segment holds a request and a     */
+/* response ring, each with a single producer and a single */
+/* consumer, so no locks or syscalls are needed while both */
+/* sides are busy. A side waiting for the other spins for  */
+/* a while and then sleeps on a futex; the spin count      */
+/* adapts to how long waits usually take.                  */
+/*                                                         */
+/* Segment layout (native byte order):                     */
+/*   segment header, then request[capacity] and            */
+/*   response[capacity]                                    */
+/* Producers must not have more than capacity requests     */
+/* outstanding, so there is always room for the responses. */
+/***********************************************************/
+
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <string>
+#include <atomic>
+#include <stdint.h>
+
+#include "deadline.h"
+
+using namespace std;
+
+class channel {
+public:
+  static const uint32_t version = 2; //2: requests carry a time limit
+  static const uint32_t capacity = 1024; //slots per ring, a power of two
+
+  enum kind { expression, entry };
+
+  struct request {
+    uint64_t tag;        //copied to the response
+    uint32_t kind;       //expression: text in expression, entry: library entry id evaluated with variables
+    uint32_t id;
+    uint32_t length;     //characters of expression or number of variables
+    uint32_t timeLimit;  //microseconds the consumer may spend on this request, 0 for its default limit
+    uint32_t reserved[2];
+    union {
+      char expression[224];
+      double variables[28];
+    };
+  };
+  struct response {
+    uint64_t tag;
+    double value;        //NaN unless state is parser::complete
+    uint32_t state;      //parser::state
+    uint32_t reserved;
+  };
+
+  channel();
+  ~channel();
+  bool create(const string& name);
+  bool attach(const string& name);
+  void close();
+  void setDeadline(const deadline *limit); //waiting gives up once limit is cancelled
+  string getError();
+
+  //producer side
+  bool send(const request& r);     //waits while the request ring is full
+  bool receive(response& r);       //waits for the next response, false once the channel is closed
+  void shutdown();                 //lets the consumer finish once it answered all requests
+
+  //consumer side
+  uint32_t pending();              //waits for requests, 0 once the channel is shut down and all requests are answered, or cancelled
+  const request& next() const;     //oldest request not answered yet
+  void respond(const response& r); //answers the oldest pending request, answers become visible on commit()
+  void commit();
+
+private:
+  struct counter {               //ring position, sleepers is nonzero while someone waits on a futex for value to change
+    alignas(64) atomic<uint32_t> value;
+    atomic<uint32_t> sleepers;
+  };
+  struct ring {
+    counter head;                //written by the producer
+    counter tail;                //written by the consumer
+  };
+  struct segment {
+    char magic[4];               //"CALC"
+    uint32_t version;
+    uint32_t slots;              //capacity of the creating build
+    atomic<uint32_t> ready;      //set by create() once the segment is initialized
+    atomic<uint32_t> closed;
+    ring requests;
+    ring responses;
+    alignas(64) request requestSlots[capacity];
+    response responseSlots[capacity];
+  };
+  bool map(const string& name, int fd);
+  uint32_t wait(counter& c, uint32_t old);
+  static void publish(counter& c, uint32_t value);
+  bool cancelled() const;
+
+  segment *p_segment;
+  const deadline *p_deadline;
+  string p_name;
+  bool p_owner;
+  unsigned int p_spin;
+  uint32_t p_requestTail;
+  uint32_t p_responseHead;
+  string p_errorstring;
+};
+
+#endif //CHANNEL_H
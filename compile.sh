@@ -1,5 +1,17 @@
 #!/bin/bash
-g++ -g -c -o main.o main.cpp &&
-g++ -g -c -o interface.o interface.cpp &&
-g++ -g -c -o parser.o parser.cpp &&
-g++ -s -o calculate main.o parser.o interface.o
+g++ -g -O2 -c -o main.o main.cpp &&
+g++ -g -O2 -c -o interface.o interface.cpp &&
+g++ -g -O2 -c -o parser.o parser.cpp &&
+g++ -g -O2 -fopenmp-simd -c -o program.o program.cpp &&
+g++ -g -O2 -c -o solver.o solver.cpp &&
+g++ -g -O2 -c -o library.o library.cpp &&
+g++ -g -O2 -c -o interval.o interval.cpp &&
+g++ -g -O2 -c -o metrics.o metrics.cpp &&
+g++ -g -O2 -fopenmp-simd -c -o value.o value.cpp &&
+g++ -g -O2 -c -o channel.o channel.cpp &&
+g++ -g -O2 -c -o summary.o summary.cpp &&
+g++ -g -O2 -c -o table.o table.cpp &&
+g++ -g -O2 -c -o deadline.o deadline.cpp &&
+g++ -g -O2 -c -o input.o input.cpp &&
+g++ -g -O2 -c -o format.o format.cpp &&
+g++ -s -pthread -o calculate main.o parser.o interface.o program.o solver.o library.o interval.o metrics.o value.o channel.o summary.o table.o deadline.o input.o format.o -lrt
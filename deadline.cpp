@@ -0,0 +1,28 @@
+/***********************************************************/
+/*              deadline class implementation              */
+/***********************************************************/
+
+#include "deadline.h"
+
+deadline::deadline() : p_limit(0), p_end(0), p_token(0) {
+}
+
+void deadline::setLimit(uint64_t nanoseconds) {
+  p_limit = nanoseconds;
+}
+
+uint64_t deadline::getLimit() const {
+  return p_limit;
+}
+
+void deadline::setToken(const atomic<bool> *token) {
+  p_token = token;
+}
+
+void deadline::start() {
+  start(p_limit);
+}
+
+void deadline::start(uint64_t nanoseconds) {
+  p_end = nanoseconds ? chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count()+nanoseconds : 0;
+}
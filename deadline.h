@@ -0,0 +1,45 @@
+/***********************************************************/
+/*                    deadline class                       */
+/* Time budget and cancellation of a single call (one      */
+/* expression, one solve, one request). Long running loops */
+/* ask passed() every now and then and give up with        */
+/* parser::timeout or parser::cancelled. The token is an   */
+/* atomic flag another thread (or a signal handler) may    */
+/* set at any time.                                        */
+/***********************************************************/
+
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+using namespace std;
+
+class deadline {
+public:
+  deadline();
+  void setLimit(uint64_t nanoseconds); //budget of every call, 0 for none
+  uint64_t getLimit() const;
+  void setToken(const atomic<bool> *token);
+  void start();                        //a new call begins, the budget counts from now
+  void start(uint64_t nanoseconds);    //same with a budget for this call only
+  bool passed() const;                 //out of time or cancelled, cheap enough to be asked every few hundred steps
+  bool cancelled() const;
+
+private:
+  uint64_t p_limit;
+  uint64_t p_end; //steady clock nanoseconds, 0 if there is no limit
+  const atomic<bool> *p_token;
+};
+
+inline bool deadline::cancelled() const {
+  return p_token && p_token->load(memory_order_relaxed);
+}
+
+inline bool deadline::passed() const {
+  return cancelled() || (p_end && (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count() >= p_end);
+}
+
+#endif //DEADLINE_H
@@ -0,0 +1,22 @@
+/***********************************************************/
+/*              number formatting implementation           */
+/***********************************************************/
+
+#include "format.h"
+#include "metrics.h"
+
+#include <charconv>
+
+using namespace std;
+
+static const unsigned int sampleRate = 64; //numbers per timed one, two clock reads cost more than formatting a number
+
+size_t formatNumber(double value, char *buffer) {
+  static thread_local unsigned int calls = 0;
+  if( calls++%sampleRate != 0 )
+    return to_chars(buffer,buffer+32,value).ptr-buffer;
+  uint64_t start = metrics::now();
+  size_t length = to_chars(buffer,buffer+32,value).ptr-buffer;
+  metrics::time(metrics::format,metrics::now()-start);
+  return length;
+}
@@ -0,0 +1,14 @@
+/***********************************************************/
+/*                 number formatting                       */
+/* Shortest text of a double that reads back as exactly    */
+/* the same double, shared by everything printing results. */
+/***********************************************************/
+
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <cstddef>
+
+size_t formatNumber(double value, char *buffer); //buffer holds at least 32 bytes, returns the length written
+
+#endif //FORMAT_H
@@ -0,0 +1,21 @@
+/***********************************************************/
+/*               input class implementation                */
+/***********************************************************/
+
+#include "input.h"
+
+#include <unistd.h>
+
+input::input(int fd) : p_fd(fd) {
+  setg(p_buffer,p_buffer,p_buffer);
+}
+
+streambuf::int_type input::underflow() {
+  if( gptr() < egptr() )
+    return traits_type::to_int_type(*gptr());
+  ssize_t length = read(p_fd,p_buffer,sizeof(p_buffer));
+  if( length <= 0 ) //end of input, error or interrupted
+    return traits_type::eof();
+  setg(p_buffer,p_buffer,p_buffer+length);
+  return traits_type::to_int_type(*gptr());
+}
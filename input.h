@@ -0,0 +1,28 @@
+/***********************************************************/
+/*                     input class                         */
+/* Stream buffer reading a file descriptor (usually        */
+/* stdin). Unlike the buffers of cin, a read interrupted   */
+/* by a signal ends the input instead of being retried,    */
+/* so modes waiting for input notice cancellation at once. */
+/***********************************************************/
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <streambuf>
+
+using namespace std;
+
+class input : public streambuf {
+public:
+  input(int fd);
+
+protected:
+  int_type underflow();
+
+private:
+  int p_fd;
+  char p_buffer[65536];
+};
+
+#endif //INPUT_H
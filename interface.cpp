@@ -7,9 +7,26 @@
 #include <iostream>
 #include <cmath>
 #include <iomanip>
+#include <cstring>
+#include <sstream>
+#include <limits>
+#include <stdint.h>
+#include <thread>
+#include <algorithm>
+#include <fstream>
+#include <sys/inotify.h>
+#include <poll.h>
 
 #include "interface.h"
 #include "parser.h"
+#include "program.h"
+#include "solver.h"
+#include "library.h"
+#include "metrics.h"
+#include "channel.h"
+#include "summary.h"
+#include "table.h"
+#include "format.h"
 
 //Linux specific
 #if defined(__GNUC__) || defined(__MINGW32__)
@@ -33,12 +50,20 @@ interface::interface() : p_poll(true) {
   p_commandMap["exit"]  = exitProgram;
   p_commandMap["quit"]  = exitProgram;
   p_commandMap["debug"] = toggleDebug;
+  p_commandMap["stats"] = showStats;
+  p_commandMap["solve"] = solveEquation;
+  p_commandMap["integrate"] = integrateExpression;
+  p_commandMap["bound"] = boundExpression;
   p_commandMap[""]      = noCommand;
 
   p_commandHelpMap[displayHelp] = "Shows this help screen";
   p_commandHelpMap[runTest] = "Runs several calculations to test the parser class";
   p_commandHelpMap[exitProgram] = "Exits the program";
   p_commandHelpMap[toggleDebug] = "Toggles algorithm debugging (you may want to use this!)";
+  p_commandHelpMap[showStats] = "Shows parser statistics and latencies";
+  p_commandHelpMap[solveEquation] = "solve(expr,x,a,b) finds a root of expr in x between a and b";
+  p_commandHelpMap[integrateExpression] = "integrate(expr,x,a,b) integrates expr over x from a to b";
+  p_commandHelpMap[boundExpression] = "bound(expr,x,a,b[,y,c,d...]) bounds expr for x in [a,b] (and y in [c,d]...)";
 
   testExpression te;
   te.expression = "4--3";
@@ -65,8 +90,27 @@ interface::interface() : p_poll(true) {
   te.result     = 0.614788;
   te.help       = "Square root, absolute value and last result (ans)";
   p_testExpressions.push_back(te);
+  te.expression = "sum([1,2,3]*2)";
+  te.result     = 12;
+  te.help       = "Vectors work element-wise, sum, mean, min, max and dot reduce them";
+  p_testExpressions.push_back(te);
+  te.expression = "if(2>1,3,1/0)";
+  te.result     = 3;
+  te.help       = "Comparisons, and, or and if(c,a,b), only the branch taken is evaluated";
+  p_testExpressions.push_back(te);
 
   cout.precision(16);
+
+  //Create parser and solver objects
+  p_parse = new parser;
+  p_solve = new solver;
+  p_parse->setDeadline(&p_deadline);
+  p_solve->setDeadline(&p_deadline);
+}
+
+interface::~interface() {
+  delete p_parse;
+  delete p_solve;
 }
 
 int interface::talk() {
@@ -79,9 +123,6 @@ int interface::talk() {
   tcsetattr( STDIN_FILENO, TCSANOW, &newt);
 #endif
 
-  //Create parser object
-  p_parse = new parser;
-
   //Welcome user
   cout << "Calculate " << version << endl;
   cout << "Enter expression. You may type \"help\"." << endl << "> ";
@@ -186,12 +227,735 @@ void interface::parse(string& str) {
   size_t pos;
   while( (pos = str.find(' ')) != str.npos )
     str.erase(pos,1);
-  if( p_parse->parse(str) == parser::complete )
-     cout << str << " = " << p_parse->result() << endl;
+  if( p_parse->parse(str) == parser::complete ) {
+    cout << str << " = ";
+    output(parser::complete,p_parse->resultValue(),string(),false);
+  }
   else
     cout << p_parse->getError() << endl;
 }
 
+//handles solve(expr,x,a,b) and integrate(expr,x,a,b), expr is compiled once and evaluated by the solver
+parser::state interface::solve(const string& str, bool integrate, double &result, string &error) {
+  vector<string> arguments;
+  if( !splitArguments(str,arguments) || arguments.size() != 4 ) {
+    error = string("Syntax error: expected ")+(integrate ? "integrate" : "solve")+"(expression,variable,from,to)";
+    return parser::syntaxerror;
+  }
+  //bounds are compiled as well, so neither of them changes ans
+  program prog;
+  vector<double> stack;
+  double bounds[2];
+  unsigned int slot = 0;
+  parser::state state = parser::complete;
+  for(int n = 0; n < 2 && state == parser::complete; n++)
+    if( (state = p_parse->compile(arguments[2+n],prog)) == parser::complete )
+      state = prog.evaluate(0,bounds[n],stack);
+  string problem = p_parse->checkName(arguments[1]);
+  if( state == parser::complete && !problem.empty() ) {
+    error = "Syntax error: variable name \""+arguments[1]+"\" "+problem;
+    return parser::syntaxerror;
+  }
+  if( state == parser::complete ) {
+    slot = p_parse->defineVariable(arguments[1]);
+    state = p_parse->compile(arguments[0],prog);
+    p_parse->clearVariables();
+  }
+  if( state != parser::complete ) {
+    error = p_parse->getError();
+    return state;
+  }
+  if( integrate )
+    state = p_solve->integrate(prog,slot,bounds[0],bounds[1],result);
+  else
+    state = p_solve->solve(prog,slot,bounds[0],bounds[1],result);
+  if( state != parser::complete ) {
+    if( state == parser::timeout || state == parser::cancelled )
+      error = programError(state);
+    else
+      error = (state == parser::matherror ? "Math error: " : "Error: ")+p_solve->getError();
+    return state;
+  }
+  p_parse->setResult(result);
+  return state;
+}
+
+//handles bound(expr,x,a,b,y,c,d,...), evaluates expr once in interval arithmetic over the box given by the variable ranges
+parser::state interface::bound(const string& str, interval &result, string &error) {
+  vector<string> arguments;
+  if( !splitArguments(str,arguments) || arguments.size() < 4 || arguments.size()%3 != 1 ) {
+    error = "Syntax error: expected bound(expression,variable,from,to[,variable,from,to...])";
+    return parser::syntaxerror;
+  }
+  program prog;
+  vector<interval> box, intervalStack;
+  parser::state state = parser::complete;
+  //a range may depend on earlier ones (bound(x*y,x,0,1,y,0,x)), so its ends are bounded over the box defined so far
+  //and the variable gets the hull of both. That box contains every point of the dependent ranges
+  for(size_t n = 1; n < arguments.size() && state == parser::complete; n += 3) {
+    interval ends[2];
+    for(int m = 0; m < 2 && state == parser::complete; m++) {
+      if( (state = p_parse->compile(arguments[n+1+m],prog)) != parser::complete )
+        error = p_parse->getError();
+      else if( (state = prog.evaluate(box.empty() ? 0 : &box[0],ends[m],intervalStack)) != parser::complete )
+        error = "Math error: Division by zero";
+      else if( ends[m].empty() ) {
+        state = parser::matherror;
+        error = "Math error: range of "+arguments[n]+" is undefined";
+      }
+    }
+    string problem = p_parse->checkName(arguments[n]);
+    if( state == parser::complete && !problem.empty() ) {
+      state = parser::syntaxerror;
+      error = "Syntax error: variable name \""+arguments[n]+"\" "+problem;
+    }
+    if( state != parser::complete )
+      break;
+    unsigned int slot = p_parse->defineVariable(arguments[n]);
+    if( box.size() <= slot )
+      box.resize(slot+1);
+    box[slot] = interval(fmin(ends[0].lower,ends[1].lower),fmax(ends[0].upper,ends[1].upper));
+  }
+  if( state == parser::complete && (state = p_parse->compile(arguments[0],prog)) != parser::complete )
+    error = p_parse->getError();
+  p_parse->clearVariables();
+  if( state != parser::complete )
+    return state;
+  if( (state = prog.evaluate(box.empty() ? 0 : &box[0],result,intervalStack)) != parser::complete )
+    error = "Math error: Division by zero";
+  return state;
+}
+
+//returns the command of built-in functions like solve(...), parseLine for everything else
+interface::command interface::builtinFunction(const string& line) {
+  string name = line.substr(0,line.find('('));
+  if( name.length() < line.length() && p_commandMap.count(name) && p_commandMap[name] >= solveEquation && p_commandMap[name] <= boundExpression )
+    return p_commandMap[name];
+  return parseLine;
+}
+
+//prints results of built-in functions in interactive mode
+void interface::function(string& str, command cmd) {
+  size_t pos;
+  while( (pos = str.find(' ')) != str.npos )
+    str.erase(pos,1);
+  string error;
+  char buffer[32];
+  if( cmd == boundExpression ) {
+    interval result;
+    if( bound(str,result,error) != parser::complete )
+      cout << error << endl;
+    else if( result.empty() )
+      cout << str << " = empty (undefined everywhere)" << endl;
+    else {
+      cout << str << " = [";
+      cout.write(buffer,formatNumber(result.lower,buffer)) << ", ";
+      cout.write(buffer,formatNumber(result.upper,buffer)) << "]" << endl;
+    }
+  }
+  else {
+    double result;
+    if( solve(str,cmd == integrateExpression,result,error) != parser::complete )
+      cout << error << endl;
+    else {
+      cout << str << " = ";
+      cout.write(buffer,formatNumber(result,buffer)) << endl;
+    }
+  }
+}
+
+//non-interactive mode, evaluates every non-empty line of in. Prints one result (or error) per line, or in binary mode
+//records of 16 bytes, see writeRecord(). Every line starts with one record, bound(...) and vectors add the records of
+//their values after it
+int interface::batch(istream& in, bool binary) {
+  ios::sync_with_stdio(false);
+  string line;
+  while( getline(in,line) ) {
+    size_t pos;
+    while( (pos = line.find_first_of(" \t\r")) != line.npos )
+      line.erase(pos,1);
+    if( line.empty() )
+      continue;
+    evaluateLine(line,binary);
+    if( p_deadline.cancelled() )
+      break;
+  }
+  cout.flush();
+  return p_deadline.cancelled() ? 1 : 0;
+}
+
+//evaluates one line without whitespace like batch() and prints its result
+parser::state interface::evaluateLine(const string& line, bool binary) {
+  p_deadline.start();
+  command cmd = builtinFunction(line);
+  string error;
+  parser::state state;
+  if( cmd == boundExpression ) {
+    interval result;
+    state = bound(line,result,error);
+    output(state,result,error,binary);
+  }
+  else if( cmd != parseLine ) {
+    double result;
+    state = solve(line,cmd == integrateExpression,result,error);
+    output(state,result,error,binary);
+  }
+  else {
+    state = p_parse->parse(line);
+    output(state,p_parse->resultValue(),state == parser::complete ? string() : p_parse->getError(),binary);
+  }
+  return state;
+}
+
+//batch mode without per-line output: only prints statistics of all results. Blocks of lines are split among one thread per cpu,
+//each with interface and summary of its own, while the next block is read. Blocks using ans are evaluated by a single thread,
+//the one that evaluated the line before, so ans refers to the same result as in batch()
+int interface::aggregate(istream& in, const summary& prototype) {
+  ios::sync_with_stdio(false);
+  unsigned int count = thread::hardware_concurrency();
+  if( count == 0 )
+    count = 1;
+  const size_t blockLines = 65536*count;
+  vector<interface*> workers(count);
+  vector<summary> summaries(count,prototype);
+  workers[0] = this;
+  for(unsigned int n = 1; n < count; n++) {
+    workers[n] = new interface;
+    workers[n]->p_deadline = p_deadline;
+  }
+  vector<string> lines, next;
+  vector<thread> threads;
+  unsigned int last = 0; //worker that evaluated the last line so far
+  bool more = true;
+  while( (more || !lines.empty()) && !p_deadline.cancelled() ) {
+    //start evaluating lines
+    bool usesAns = false;
+    for(vector<string>::iterator it = lines.begin(); !usesAns && it != lines.end(); it++)
+      usesAns = it->find("ans") != it->npos || it->find("ANS") != it->npos;
+    if( usesAns )
+      threads.push_back(thread(accumulateLines,workers[last],&lines,0,lines.size(),&summaries[last]));
+    else if( !lines.empty() ) {
+      size_t share = (lines.size()+count-1)/count;
+      for(unsigned int n = 0; n*share < lines.size(); n++) {
+        threads.push_back(thread(accumulateLines,workers[n],&lines,n*share,min(lines.size(),(n+1)*share),&summaries[n]));
+        last = n;
+      }
+    }
+    //meanwhile read the next block
+    next.clear();
+    string line;
+    while( more && next.size() < blockLines ) {
+      if( !getline(in,line) ) {
+        more = false;
+        break;
+      }
+      size_t pos;
+      while( (pos = line.find_first_of(" \t\r")) != line.npos )
+        line.erase(pos,1);
+      if( !line.empty() )
+        next.push_back(line);
+    }
+    for(vector<thread>::iterator it = threads.begin(); it != threads.end(); it++)
+      it->join();
+    threads.clear();
+    lines.swap(next);
+  }
+  for(unsigned int n = 1; n < count; n++) {
+    summaries[0].merge(summaries[n]);
+    delete workers[n];
+  }
+  cout << summaries[0].report();
+  cout.flush();
+  return p_deadline.cancelled() ? 1 : 0;
+}
+
+void interface::accumulateLines(interface *worker, const vector<string> *lines, size_t begin, size_t end, summary *s) {
+  for(size_t n = begin; n < end && !worker->p_deadline.cancelled(); n++)
+    worker->accumulate((*lines)[n],*s);
+}
+
+//evaluate line like batch() does and add its results to s
+void interface::accumulate(const string& line, summary& s) {
+  p_deadline.start();
+  command cmd = builtinFunction(line);
+  string error;
+  parser::state state;
+  if( cmd == boundExpression ) {
+    interval result;
+    if( (state = bound(line,result,error)) == parser::complete ) {
+      s.add(result.lower);
+      s.add(result.upper);
+    }
+  }
+  else if( cmd != parseLine ) {
+    double result;
+    if( (state = solve(line,cmd == integrateExpression,result,error)) == parser::complete )
+      s.add(result);
+  }
+  else if( (state = p_parse->parse(line)) == parser::complete ) {
+    const value &result = p_parse->resultValue();
+    if( result.isVector() )
+      for(vector<double>::const_iterator it = result.elements().begin(); it != result.elements().end(); it++)
+        s.add(*it);
+    else
+      s.add(result.scalar());
+  }
+  if( state != parser::complete )
+    s.fail(state);
+}
+
+//evaluates all of in as one single expression, which is passed to the parser in chunks, so it never has to be in memory as a whole
+int interface::stream(istream& in, bool binary) {
+  ios::sync_with_stdio(false);
+  string chunk(65536,0);
+  p_deadline.start();
+  p_parse->begin();
+  while( in.read(&chunk[0],chunk.size()) || in.gcount() > 0 ) {
+    if( p_parse->feed(chunk.substr(0,in.gcount())) != parser::running )
+      break;
+  }
+  parser::state state = p_deadline.cancelled() ? parser::cancelled : p_parse->finish(); //reading may have been interrupted
+  output(state,p_parse->resultValue(),state == parser::complete ? string() : state == parser::cancelled ? programError(state) : p_parse->getError(),binary);
+  cout.flush();
+  return state == parser::complete ? 0 : 1;
+}
+
+//evaluates every line of the file path like batch(), then again whenever the file is saved, printing only changed results as a diff.
+//Results are cached by line text, so only edited lines and lines whose ans changed are evaluated again. Runs until cancelled
+int interface::watch(const string& path) {
+  ios::sync_with_stdio(false);
+  size_t slash = path.rfind('/');
+  string directory = slash == path.npos ? "." : path.substr(0,slash ? slash : 1), name = path.substr(slash+1);
+  int fd = inotify_init1(IN_CLOEXEC);
+  if( fd < 0 || inotify_add_watch(fd,directory.c_str(),IN_CLOSE_WRITE|IN_MOVED_TO) < 0 ) { //editors often save by renaming a new file, so watch the directory
+    cerr << "unable to watch " << path << endl;
+    if( fd >= 0 )
+      close(fd);
+    return 1;
+  }
+  map<string,cachedLine> cache;
+  vector<string> shown;
+  bool first = true;
+  while( !p_deadline.cancelled() ) {
+    ifstream in(path.c_str());
+    if( !in )
+      cerr << "unable to read " << path << endl;
+    else {
+      map<string,cachedLine> used;
+      vector<string> results;
+      vector<size_t> lines;
+      size_t evaluated = 0;
+      p_parse->setResult(numeric_limits<double>::quiet_NaN()); //every pass starts without ans, like batch()
+      string line;
+      for(size_t number = 1; getline(in,line) && !p_deadline.cancelled(); number++) {
+        size_t pos;
+        while( (pos = line.find_first_of(" \t\r")) != line.npos )
+          line.erase(pos,1);
+        if( line.empty() )
+          continue;
+        bool usesAns = line.find("ans") != line.npos || line.find("ANS") != line.npos;
+        value ansIn = p_parse->answer();
+        map<string,cachedLine>::iterator it = cache.find(line);
+        if( it != cache.end() && (identical(it->second.ansIn,ansIn) || (!usesAns && (it->second.setsAns || it->second.keepsAns))) ) {
+          if( !it->second.keepsAns )
+            p_parse->setResult(it->second.ansOut);
+        }
+        else {
+          ostringstream captured;
+          streambuf *original = cout.rdbuf(captured.rdbuf());
+          parser::state state = evaluateLine(line,false);
+          cout.rdbuf(original);
+          cachedLine c;
+          c.output = captured.str();
+          c.output.erase(c.output.length()-1);
+          c.ansIn = ansIn;
+          c.ansOut = p_parse->answer();
+          command cmd = builtinFunction(line);
+          c.setsAns = state == parser::complete && cmd != boundExpression;
+          c.keepsAns = !c.setsAns && cmd != parseLine; //built-in functions compile their arguments, which leaves ans alone
+          it = cache.insert(make_pair(line,c)).first;
+          it->second = c;
+          evaluated++;
+        }
+        used.insert(*it);
+        results.push_back(line+" = "+it->second.output);
+        lines.push_back(number);
+      }
+      if( p_deadline.cancelled() )
+        break;
+      cache.swap(used); //forget lines that were deleted
+      if( first )
+        for(size_t n = 0; n < results.size(); n++)
+          cout << results[n] << '\n';
+      else
+        printDiff(shown,results,lines);
+      cout.flush();
+      cerr << path << ": evaluated " << evaluated << " of " << results.size() << " lines" << endl;
+      shown.swap(results);
+      first = false;
+    }
+    //wait until path is written again
+    bool changed = false;
+    while( !changed && !p_deadline.cancelled() ) {
+      struct pollfd ready = { fd, POLLIN, 0 };
+      if( poll(&ready,1,-1) <= 0 ) //interrupted, maybe cancelled
+        continue;
+      char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+      ssize_t length = read(fd,buffer,sizeof(buffer));
+      for(ssize_t offset = 0; offset < length; ) {
+        const struct inotify_event *event = (const struct inotify_event*)(buffer+offset);
+        if( event->len && name == event->name )
+          changed = true;
+        offset += sizeof(struct inotify_event)+event->len;
+      }
+    }
+  }
+  close(fd);
+  return 0;
+}
+
+//prints the difference of the results before and after (the file lines of after are in lines) as hunks of
+//removed (-) and added (+) results, each headed by the line of the new file it starts at
+void interface::printDiff(const vector<string>& before, const vector<string>& after, const vector<size_t>& lines) {
+  //results outside of the edited region are usually unchanged
+  size_t prefix = 0, suffix = 0;
+  while( prefix < before.size() && prefix < after.size() && before[prefix] == after[prefix] )
+    prefix++;
+  while( suffix < before.size()-prefix && suffix < after.size()-prefix && before[before.size()-1-suffix] == after[after.size()-1-suffix] )
+    suffix++;
+  size_t n = before.size()-prefix-suffix, m = after.size()-prefix-suffix;
+  //longest common subsequence of the rest, lcs[i*(m+1)+j] covers before[prefix+i...] and after[prefix+j...]
+  vector<uint32_t> lcs;
+  if( n*m <= 16*1024*1024 ) {
+    lcs.assign((n+1)*(m+1),0);
+    for(size_t i = n; i-- > 0; )
+      for(size_t j = m; j-- > 0; )
+        lcs[i*(m+1)+j] = before[prefix+i] == after[prefix+j] ? lcs[(i+1)*(m+1)+j+1]+1 : max(lcs[(i+1)*(m+1)+j],lcs[i*(m+1)+j+1]);
+  }
+  size_t i = 0, j = 0;
+  bool inHunk = false;
+  while( i < n || j < m ) {
+    if( i < n && j < m && before[prefix+i] == after[prefix+j] && !lcs.empty() ) {
+      i++;
+      j++;
+      inHunk = false;
+      continue;
+    }
+    if( !inHunk ) {
+      size_t line = prefix+j < after.size() ? lines[prefix+j] : (after.empty() ? 1 : lines.back()+1);
+      cout << "@@ line " << line << " @@\n";
+      inHunk = true;
+    }
+    if( i < n && (j == m || lcs.empty() || lcs[(i+1)*(m+1)+j] >= lcs[i*(m+1)+j+1]) )
+      cout << '-' << before[prefix+i++] << '\n';
+    else
+      cout << '+' << after[prefix+j++] << '\n';
+  }
+}
+
+//same type, same elements, NaN equals NaN
+bool interface::identical(const value& a, const value& b) {
+  if( a.isVector() != b.isVector() )
+    return false;
+  if( !a.isVector() )
+    return a.scalar() == b.scalar() || (a.scalar() != a.scalar() && b.scalar() != b.scalar());
+  if( a.elements().size() != b.elements().size() )
+    return false;
+  for(size_t n = 0; n < a.elements().size(); n++)
+    if( !(a.elements()[n] == b.elements()[n] || (a.elements()[n] != a.elements()[n] && b.elements()[n] != b.elements()[n])) )
+      return false;
+  return true;
+}
+
+//reads one expression per line of in and stores them compiled in the library file path. variables may be used in the expressions, their index is their slot
+int interface::compileLibrary(istream& in, const string& path, const vector<string>& variables) {
+  for(vector<string>::const_iterator it = variables.begin(); it != variables.end(); it++) {
+    string problem = p_parse->checkName(*it);
+    if( !problem.empty() ) {
+      cerr << "variable name \"" << *it << "\" " << problem << endl;
+      return 1;
+    }
+    p_parse->defineVariable(*it);
+  }
+  vector<program> programs;
+  string line;
+  for(int number = 1; getline(in,line); number++) {
+    size_t pos;
+    while( (pos = line.find_first_of(" \t\r")) != line.npos )
+      line.erase(pos,1);
+    if( line.empty() )
+      continue;
+    programs.push_back(program());
+    if( p_parse->compile(line,programs.back()) != parser::complete ) {
+      cerr << "line " << number << ": " << p_parse->getError() << endl;
+      return 1;
+    }
+  }
+  library lib;
+  if( !lib.save(path,programs) ) {
+    cerr << lib.getError() << endl;
+    return 1;
+  }
+  return 0;
+}
+
+//evaluates every expression of the library file path. If they use variables, in has to provide one line of values per evaluation
+int interface::runLibrary(const string& path, istream& in, bool binary) {
+  ios::sync_with_stdio(false);
+  library lib;
+  if( !lib.load(path) ) {
+    cerr << lib.getError() << endl;
+    return 1;
+  }
+  program prog;
+  vector<double> variables(lib.variableCount()), stack;
+  string line;
+  while( variables.empty() || getline(in,line) ) {
+    istringstream values(line);
+    unsigned int n = 0;
+    while( n < variables.size() && values >> variables[n] )
+      n++;
+    if( n < variables.size() ) {
+      cerr << "expected " << variables.size() << " variable values, got \"" << line << "\"" << endl;
+      return 1;
+    }
+    p_deadline.start();
+    for(size_t index = 0; index < lib.size(); index++) {
+      double value = numeric_limits<double>::quiet_NaN();
+      parser::state state = parser::timeout;
+      if( !p_deadline.passed() ) {
+        lib.get(index,prog);
+        state = prog.evaluate(variables.empty() ? 0 : &variables[0],value,stack);
+      }
+      else if( p_deadline.cancelled() )
+        state = parser::cancelled;
+      output(state,value,programError(state),binary);
+    }
+    if( variables.empty() || p_deadline.cancelled() )
+      break;
+  }
+  cout.flush();
+  return p_deadline.cancelled() ? 1 : 0;
+}
+
+//evaluates expression for every row of the table file path, its columns are the variables. Without names path is CSV,
+//otherwise raw columnar binary with these column names. Rows are evaluated in blocks, only blocks with math errors are
+//evaluated again row by row to find the rows that failed
+int interface::evaluateTable(const string& path, const vector<string>& names, const string& expression, bool binary) {
+  ios::sync_with_stdio(false);
+  table data;
+  if( !(names.empty() ? data.loadCSV(path) : data.loadBinary(path,names)) ) {
+    cerr << data.getError() << endl;
+    return 1;
+  }
+  p_parse->clearVariables();
+  for(size_t n = 0; n < data.names().size(); n++) {
+    string problem = p_parse->checkName(data.names()[n]);
+    if( !problem.empty() ) {
+      cerr << "column name \"" << data.names()[n] << "\" " << problem << endl;
+      return 1;
+    }
+    if( p_parse->defineVariable(data.names()[n]) != n ) {
+      cerr << "column " << data.names()[n] << " appears twice" << endl;
+      return 1;
+    }
+  }
+  program prog;
+  if( p_parse->compile(expression,prog) != parser::complete ) {
+    cerr << p_parse->getError() << endl;
+    return 1;
+  }
+  const size_t chunk = 4096;
+  size_t columns = data.names().size();
+  vector<const double*> offsets(columns);
+  vector<double> results(chunk), row(columns), stack;
+  p_deadline.start();
+  for(size_t offset = 0; offset < data.rows(); offset += chunk) {
+    if( p_deadline.passed() ) {
+      cout.flush();
+      cerr << programError(p_deadline.cancelled() ? parser::cancelled : parser::timeout) << " after " << offset << " rows" << endl;
+      return 1;
+    }
+    size_t count = min(chunk,data.rows()-offset);
+    for(size_t n = 0; n < columns; n++)
+      offsets[n] = data.column(n)+offset;
+    parser::state state = prog.evaluate(&offsets[0],count,&results[0],stack);
+    for(size_t i = 0; i < count; i++) {
+      if( state != parser::complete ) {
+        for(size_t n = 0; n < columns; n++)
+          row[n] = offsets[n][i];
+        state = prog.evaluate(&row[0],results[i],stack);
+        output(state,results[i],programError(state),binary);
+        state = parser::matherror; //keep checking the rows of this block one by one
+      }
+      else
+        output(state,results[i],string(),binary);
+    }
+  }
+  cout.flush();
+  return 0;
+}
+
+//answers requests of producers attached to the shared memory channel name until they shut it down.
+//Expression requests are parsed like lines in batch mode, entry requests evaluate an expression of the library file path
+int interface::serve(const string& name, const string& path) {
+  library lib;
+  if( !path.empty() && !lib.load(path) ) {
+    cerr << lib.getError() << endl;
+    return 1;
+  }
+  channel ch;
+  if( !ch.create(name) ) {
+    cerr << ch.getError() << endl;
+    return 1;
+  }
+  ch.setDeadline(&p_deadline);
+  program prog;
+  vector<double> stack;
+  uint32_t count;
+  while( (count = ch.pending()) ) {
+    for(uint32_t n = 0; n < count; n++) {
+      const channel::request &r = ch.next();
+      //the producer can still write the shared request, read each field once so the checks hold for what is used
+      const uint32_t kind = r.kind, id = r.id, length = r.length, timeLimit = r.timeLimit;
+      channel::response answer;
+      answer.tag = r.tag;
+      answer.value = numeric_limits<double>::quiet_NaN();
+      answer.reserved = 0;
+      parser::state state = parser::syntaxerror;
+      p_deadline.start(timeLimit ? timeLimit*(uint64_t)1000 : p_deadline.getLimit());
+      if( kind == channel::expression && length <= sizeof(r.expression) ) {
+        state = p_parse->parse(string(r.expression,length));
+        if( state == parser::complete )
+          answer.value = p_parse->result();
+      }
+      else if( kind == channel::entry && lib.get(id,prog) && length >= prog.variableCount() && length <= sizeof(r.variables)/sizeof(double) )
+        state = prog.evaluate(r.variables,answer.value,stack);
+      answer.state = state;
+      ch.respond(answer);
+    }
+    ch.commit();
+  }
+  return p_deadline.cancelled() ? 1 : 0; //ch removes the segment
+}
+
+//time limit of every line, request or table, 0 for none
+void interface::setTimeLimit(uint64_t nanoseconds) {
+  p_deadline.setLimit(nanoseconds);
+}
+
+//once token is set, running evaluations end as parser::cancelled and batch modes stop reading input
+void interface::setCancelToken(const atomic<bool> *token) {
+  p_deadline.setToken(token);
+}
+
+//error message of states returned by program::evaluate(), which has no error strings. Time limits and cancellation
+//are reported with these texts everywhere, parser::getError() and solver::getError() use the same ones
+const char* interface::programError(parser::state state) {
+  switch( state ) {
+    case parser::matherror : return "Math error";
+    case parser::timeout   : return "Time limit exceeded";
+    case parser::cancelled : return "Cancelled";
+    default                : return "Internal error";
+  }
+}
+
+//writes a binary record of 16 bytes: value as little-endian double, a status byte holding state, a byte holding kind, 2 zero
+//bytes and count as little-endian 32 bit integer. Every double of the output stays 8 byte aligned
+void interface::writeRecord(parser::state state, double value, recordKind kind, uint32_t count) {
+  char buffer[16];
+  uint64_t bits;
+  if( state != parser::complete )
+    value = numeric_limits<double>::quiet_NaN();
+  memcpy(&bits,&value,sizeof(bits));
+  for(int n = 0; n < 8; n++)
+    buffer[n] = bits >> 8*n;
+  buffer[8] = state;
+  buffer[9] = kind;
+  buffer[10] = buffer[11] = 0;
+  for(int n = 0; n < 4; n++)
+    buffer[12+n] = count >> 8*n;
+  cout.write(buffer,16);
+}
+
+//prints one result, or in binary mode writes it as a single scalar record
+void interface::output(parser::state state, double value, const string& error, bool binary) {
+  char buffer[32];
+  if( binary )
+    writeRecord(state,value,scalarRecord,0);
+  else if( state == parser::complete ) {
+    size_t length = formatNumber(value,buffer);
+    buffer[length] = '\n';
+    cout.write(buffer,length+1);
+  }
+  else
+    cout << error << '\n';
+}
+
+//bounds are printed as [lower, upper], in binary mode as a bound record counting the 2 scalar records of lower and upper that follow it
+void interface::output(parser::state state, const interval& result, const string& error, bool binary) {
+  char buffer[32];
+  if( binary ) {
+    writeRecord(state,numeric_limits<double>::quiet_NaN(),boundRecord,state == parser::complete ? 2 : 0);
+    if( state == parser::complete ) {
+      writeRecord(state,result.lower,scalarRecord,0);
+      writeRecord(state,result.upper,scalarRecord,0);
+    }
+  }
+  else if( state == parser::complete ) {
+    cout << '[';
+    cout.write(buffer,formatNumber(result.lower,buffer)) << ", ";
+    cout.write(buffer,formatNumber(result.upper,buffer)) << "]\n";
+  }
+  else
+    cout << error << '\n';
+}
+
+//vectors are printed as [a, b, c], in binary mode as a vector record counting the scalar records of the elements that follow it
+void interface::output(parser::state state, const value& result, const string& error, bool binary) {
+  if( state != parser::complete || !result.isVector() ) {
+    output(state,result.scalar(),error,binary);
+    return;
+  }
+  if( binary ) {
+    writeRecord(state,numeric_limits<double>::quiet_NaN(),vectorRecord,result.elements().size());
+    for(vector<double>::const_iterator it = result.elements().begin(); it != result.elements().end(); it++)
+      writeRecord(state,*it,scalarRecord,0);
+    return;
+  }
+  char buffer[32];
+  cout << '[';
+  for(vector<double>::const_iterator it = result.elements().begin(); it != result.elements().end(); it++) {
+    if( it != result.elements().begin() )
+      cout << ", ";
+    cout.write(buffer,formatNumber(*it,buffer));
+  }
+  cout << "]\n";
+}
+
+//splits "name(a,b,...)" into its arguments, only commas outside of parentheses separate them
+bool interface::splitArguments(const string& line, vector<string>& arguments) {
+  size_t begin = line.find('(');
+  if( begin == line.npos || line[line.length()-1] != ')' )
+    return false;
+  int depth = 0;
+  string argument;
+  for(size_t n = begin+1; n < line.length()-1; n++) {
+    if( line[n] == '(' || line[n] == '[' )
+      depth++;
+    else if( (line[n] == ')' || line[n] == ']') && --depth < 0 )
+      return false;
+    if( line[n] == ',' && depth == 0 ) {
+      arguments.push_back(argument);
+      argument.clear();
+    }
+    else
+      argument += line[n];
+  }
+  arguments.push_back(argument);
+  return depth == 0;
+}
+
 void interface::help() {
   cout << "Built-in commands:" << endl;
   string str;
@@ -218,9 +982,12 @@ void interface::test() {
 }
 
 void interface::processLine() {
+  p_deadline.start();
   command cmd = parseLine;
   if( p_commandMap.count(*p_commandHistoryIterator) ) //Handle built-in commands
     cmd = p_commandMap[*p_commandHistoryIterator];
+  else //Handle built-in functions like solve(...)
+    cmd = builtinFunction(*p_commandHistoryIterator);
   switch( cmd ) {
     case displayHelp : help();
                        break;
@@ -231,6 +998,12 @@ void interface::processLine() {
     case toggleDebug : p_parse->setDebug(!p_parse->getDebug());
                        cout << "Debugging information " << (p_parse->getDebug() ? "enabled" : "disabled") << endl;
                        break;
+    case solveEquation       :
+    case integrateExpression :
+    case boundExpression     : function(*p_commandHistoryIterator,cmd);
+                               break;
+    case showStats   : cout << metrics::report();
+                       break;
     case noCommand   : break;
     default          : parse(*p_commandHistoryIterator);
   }
@@ -15,21 +15,54 @@
 #include <string>
 #include <map>
 #include <list>
+#include <vector>
+#include <istream>
+#include <atomic>
+
+#include "parser.h"
+#include "interval.h"
+#include "deadline.h"
 
 using namespace std;
 
 static const char version[] = "0.7b";
 
-class parser;
+class solver;
+class summary;
 
 class interface {
 public:
   interface();
+  ~interface();
   int talk();
+  int batch(istream& in, bool binary);
+  int stream(istream& in, bool binary);
+  int aggregate(istream& in, const summary& prototype);
+  int compileLibrary(istream& in, const string& path, const vector<string>& variables);
+  int runLibrary(const string& path, istream& in, bool binary);
+  int evaluateTable(const string& path, const vector<string>& names, const string& expression, bool binary);
+  int serve(const string& name, const string& path);
+  int watch(const string& path);
+  void setTimeLimit(uint64_t nanoseconds);
+  void setCancelToken(const atomic<bool> *token);
 private:
   void help();
   void test();
   void parse(string&);
+  enum recordKind { scalarRecord, boundRecord, vectorRecord }; //bound and vector records are followed by count scalar records
+  void writeRecord(parser::state state, double value, recordKind kind, uint32_t count);
+  void output(parser::state state, double value, const string& error, bool binary);
+  void output(parser::state state, const interval& result, const string& error, bool binary);
+  static const char* programError(parser::state state);
+  void output(parser::state state, const value& result, const string& error, bool binary);
+  parser::state solve(const string& str, bool integrate, double &result, string &error);
+  parser::state bound(const string& str, interval &result, string &error);
+  bool splitArguments(const string& line, vector<string>& arguments);
+  parser::state evaluateLine(const string& line, bool binary);
+  void printDiff(const vector<string>& before, const vector<string>& after, const vector<size_t>& lines);
+  static bool identical(const value& a, const value& b);
+  void accumulate(const string& line, summary& s);
+  static void accumulateLines(interface *worker, const vector<string> *lines, size_t begin, size_t end, summary *s);
   void processLine();
   void clearLine();
   void showPreviousExpression();
@@ -43,12 +76,16 @@ private:
   void deleteCharacterReverse();
 
   parser *p_parse;
+  solver *p_solve;
+  deadline p_deadline; //shared by p_parse and p_solve, started for every line or request
   deque<string> p_commandHistory;
   deque<string>::iterator p_commandHistoryIterator;
   string::iterator p_commandIterator;
   bool p_poll;
 
-  enum command { parseLine, displayHelp, runTest, exitProgram, toggleDebug, noCommand };
+  enum command { parseLine, displayHelp, runTest, exitProgram, toggleDebug, showStats, solveEquation, integrateExpression, boundExpression, noCommand };
+  command builtinFunction(const string& line);
+  void function(string&, command cmd);
   map<string,command> p_commandMap;
   map<command,string> p_commandHelpMap;
   struct testExpression {
@@ -57,6 +94,13 @@ private:
     string help;
   };
   list<testExpression> p_testExpressions;
+  struct cachedLine { //result of a line in watch mode
+    string output;
+    value ansIn;   //ans when it was evaluated
+    value ansOut;  //ans after it
+    bool setsAns;  //ansOut does not depend on ansIn
+    bool keepsAns; //ansOut is ansIn
+  };
 };
 
 #endif //INTERFACE_H
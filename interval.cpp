@@ -0,0 +1,244 @@
+/***********************************************************/
+/*             interval class implementation               */
+/***********************************************************/
+
+#include "interval.h"
+#include "parser.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+#ifdef M_PI
+  const double LPI = M_PI;
+#else
+  const double LPI = 3.14159;
+#endif
+
+static const double infinity = numeric_limits<double>::infinity();
+
+//products of infinite and zero bounds are zero, the zero bound is reached while the infinite one is not
+static double product(double a, double b) {
+  return a == 0 || b == 0 ? 0 : a*b;
+}
+
+static double minimum(double a, double b, double c, double d) {
+  return fmin(fmin(a,b),fmin(c,d));
+}
+
+static double maximum(double a, double b, double c, double d) {
+  return fmax(fmax(a,b),fmax(c,d));
+}
+
+interval::interval() : lower(0), upper(0) {
+}
+
+interval::interval(double value) : lower(value), upper(value) {
+}
+
+interval::interval(double l, double u) : lower(l), upper(u) {
+}
+
+bool interval::empty() const {
+  return lower != lower || upper != upper || lower > upper;
+}
+
+bool interval::contains(double value) const {
+  return lower <= value && value <= upper;
+}
+
+interval interval::entire() {
+  return interval(-infinity,infinity);
+}
+
+interval interval::add(const interval& a, const interval& b) {
+  if( a.empty() || b.empty() )
+    return interval(numeric_limits<double>::quiet_NaN());
+  return widen(a.lower+b.lower,a.upper+b.upper);
+}
+
+interval interval::subtract(const interval& a, const interval& b) {
+  if( a.empty() || b.empty() )
+    return interval(numeric_limits<double>::quiet_NaN());
+  return widen(a.lower-b.upper,a.upper-b.lower);
+}
+
+interval interval::multiply(const interval& a, const interval& b) {
+  if( a.empty() || b.empty() )
+    return interval(numeric_limits<double>::quiet_NaN());
+  double p1 = product(a.lower,b.lower), p2 = product(a.lower,b.upper), p3 = product(a.upper,b.lower), p4 = product(a.upper,b.upper);
+  return widen(minimum(p1,p2,p3,p4),maximum(p1,p2,p3,p4));
+}
+
+//a divisor containing zero may produce any value (the point evaluation fails only for exactly zero)
+interval interval::divide(const interval& a, const interval& b) {
+  if( a.empty() || b.empty() )
+    return interval(numeric_limits<double>::quiet_NaN());
+  if( b.contains(0) )
+    return entire();
+  double q1 = a.lower/b.lower, q2 = a.lower/b.upper, q3 = a.upper/b.lower, q4 = a.upper/b.upper;
+  return widen(minimum(q1,q2,q3,q4),maximum(q1,q2,q3,q4));
+}
+
+interval interval::power(const interval& a, const interval& b) {
+  if( a.empty() || b.empty() )
+    return interval(numeric_limits<double>::quiet_NaN());
+  if( b.lower == b.upper && b.lower == floor(b.lower) && fabs(b.lower) < infinity )
+    return integerPower(a,b.lower);
+  if( a.lower < 0 ) { //negative bases only give results for integer exponents, their magnitude is bounded by the one of |a|^b
+    double m = fmax(-a.lower,a.upper);
+    double p1 = pow(m,b.lower), p2 = pow(m,b.upper), p3 = pow(0.0,b.lower), p4 = pow(0.0,b.upper);
+    m = maximum(p1,p2,p3,p4);
+    if( m != m )
+      return entire();
+    return widen(-m,m);
+  }
+  //x^y is monotonic in both x >= 0 and y, so the corners bound it
+  double p1 = pow(a.lower,b.lower), p2 = pow(a.lower,b.upper), p3 = pow(a.upper,b.lower), p4 = pow(a.upper,b.upper);
+  interval r = widen(minimum(p1,p2,p3,p4),maximum(p1,p2,p3,p4));
+  if( r.lower < 0 )
+    r.lower = 0;
+  return r;
+}
+
+interval interval::function(unsigned int op, const interval& a) {
+  if( a.empty() )
+    return a;
+  interval r;
+  switch( op ) {
+    case operators::negation : return interval(-a.upper,-a.lower);
+    case operators::sin      : return trig(a,false);
+    case operators::cos      : return trig(a,true);
+    case operators::tan      : return tan(a);
+    case operators::arcsin   : if( a.lower > 1 || a.upper < -1 )
+                                 return interval(numeric_limits<double>::quiet_NaN());
+                               r = widen(asin(fmax(a.lower,-1.0)),asin(fmin(a.upper,1.0)));
+                               return widen(r.lower,r.upper);
+    case operators::arccos   : if( a.lower > 1 || a.upper < -1 )
+                                 return interval(numeric_limits<double>::quiet_NaN());
+                               r = widen(acos(fmin(a.upper,1.0)),acos(fmax(a.lower,-1.0)));
+                               r = widen(r.lower,r.upper);
+                               if( r.lower < 0 )
+                                 r.lower = 0;
+                               return r;
+    case operators::arctan   : r = widen(atan(a.lower),atan(a.upper));
+                               return widen(r.lower,r.upper);
+    case operators::sqrt     : if( a.upper < 0 )
+                                 return interval(numeric_limits<double>::quiet_NaN());
+                               r = widen(sqrt(fmax(a.lower,0.0)),sqrt(a.upper));
+                               if( r.lower < 0 )
+                                 r.lower = 0;
+                               return r;
+    case operators::abs      : if( a.lower >= 0 )
+                                 return a;
+                               if( a.upper <= 0 )
+                                 return interval(-a.upper,-a.lower);
+                               return interval(0,fmax(-a.lower,a.upper));
+    case operators::sum      :
+    case operators::mean     :
+    case operators::min      :
+    case operators::max      : return a; //reductions of a scalar
+  }
+  return interval(numeric_limits<double>::quiet_NaN());
+}
+
+interval interval::compare(unsigned int op, const interval& a, const interval& b) {
+  if( a.empty() || b.empty() )
+    return interval(numeric_limits<double>::quiet_NaN());
+  bool yes = false, no = false;
+  switch( op ) {
+    case operators::equal        :
+    case operators::notEqual     : yes = a.lower == a.upper && b.lower == b.upper && a.lower == b.lower;
+                                   no = a.upper < b.lower || b.upper < a.lower;
+                                   if( op == operators::notEqual )
+                                     swap(yes,no);
+                                   break;
+    case operators::less         : yes = a.upper < b.lower;
+                                   no = a.lower >= b.upper;
+                                   break;
+    case operators::lessEqual    : yes = a.upper <= b.lower;
+                                   no = a.lower > b.upper;
+                                   break;
+    case operators::greater      : return compare(operators::less,b,a);
+    case operators::greaterEqual : return compare(operators::lessEqual,b,a);
+    case operators::logicalAnd   : yes = !a.contains(0) && !b.contains(0);
+                                   no = (a.lower == 0 && a.upper == 0) || (b.lower == 0 && b.upper == 0);
+                                   break;
+    case operators::logicalOr    : yes = !a.contains(0) || !b.contains(0);
+                                   no = a.lower == 0 && a.upper == 0 && b.lower == 0 && b.upper == 0;
+                                   break;
+    default                      : return interval(numeric_limits<double>::quiet_NaN());
+  }
+  return yes ? interval(1) : (no ? interval(0) : interval(0,1));
+}
+
+//smallest interval containing a and b, empty ones are ignored
+interval interval::hull(const interval& a, const interval& b) {
+  if( a.empty() )
+    return b;
+  if( b.empty() )
+    return a;
+  return interval(fmin(a.lower,b.lower),fmax(a.upper,b.upper));
+}
+
+//round outwards by one unit in the last place
+interval interval::widen(double l, double u) {
+  return interval(nextafter(l,-infinity),nextafter(u,infinity));
+}
+
+//true if offset+k*period lies in [l,u] for some integer k, errs on the side of true
+bool interval::hits(double l, double u, double offset, double period) {
+  double k = ceil((l-offset)/period-1e-9);
+  return offset+k*period <= u+1e-9*period*(1+fabs(k));
+}
+
+//sin and cos, extrema are reached where a contains their argument
+interval interval::trig(const interval& a, bool cosine) {
+  if( fabs(a.lower) == infinity || fabs(a.upper) == infinity || a.upper-a.lower >= 2*LPI )
+    return interval(-1,1);
+  double vl = cosine ? cos(a.lower) : sin(a.lower), vu = cosine ? cos(a.upper) : sin(a.upper);
+  //libm may be off by an ulp, value::function() additionally rounds tiny values to zero
+  double tolerance = 4*numeric_limits<double>::epsilon()*(1+2*fmax(fabs(a.lower),fabs(a.upper))/LPI);
+  interval r(fmax(fmin(vl,vu)-tolerance,-1.0),fmin(fmax(vl,vu)+tolerance,1.0));
+  double maximumAt = cosine ? 0 : LPI/2;
+  if( hits(a.lower,a.upper,maximumAt,2*LPI) )
+    r.upper = 1;
+  if( hits(a.lower,a.upper,maximumAt+LPI,2*LPI) )
+    r.lower = -1;
+  return r;
+}
+
+//tan is increasing between its poles, anything containing a pole may reach any value
+interval interval::tan(const interval& a) {
+  if( a.upper-a.lower >= LPI || hits(a.lower,a.upper,LPI/2,LPI) )
+    return entire();
+  double vl = ::tan(a.lower), vu = ::tan(a.upper);
+  double tolerance = 4*numeric_limits<double>::epsilon()*(1+2*fmax(fabs(a.lower),fabs(a.upper))/LPI);
+  if( fabs(vl) == infinity || fabs(vu) == infinity || 1/fabs(vl) < tolerance || 1/fabs(vu) < tolerance )
+    return entire();
+  return interval(vl-tolerance*(1+fabs(vl)),vu+tolerance*(1+fabs(vu)));
+}
+
+//a^n for integer n, also defined for negative a
+interval interval::integerPower(const interval& a, double n) {
+  if( n == 0 )
+    return interval(1);
+  if( n < 0 )
+    return divide(interval(1),integerPower(a,-n));
+  double pl = pow(a.lower,n), pu = pow(a.upper,n);
+  interval r;
+  if( fmod(n,2) != 0 ) //odd, increasing
+    r = widen(pl,pu);
+  else if( a.lower >= 0 )
+    r = widen(pl,pu);
+  else if( a.upper <= 0 )
+    r = widen(pu,pl);
+  else
+    r = widen(0,fmax(pl,pu));
+  r = widen(r.lower,r.upper);
+  if( fmod(n,2) == 0 && r.lower < 0 )
+    r.lower = 0;
+  return r;
+}
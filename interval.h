@@ -0,0 +1,44 @@
+/***********************************************************/
+/*                    interval class                       */
+/* Closed interval [lower,upper] of doubles. The operators */
+/* return intervals that enclose every result the point    */
+/* evaluation could produce for arguments inside their     */
+/* operands, so one evaluation bounds an expression over a */
+/* whole box. Bounds are rounded outwards. Parts outside   */
+/* of a function's domain are dropped, an interval that is */
+/* completely outside becomes empty (NaN bounds).          */
+/***********************************************************/
+
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+class interval {
+public:
+  interval();
+  interval(double value);
+  interval(double l, double u);
+  bool empty() const;
+  bool contains(double value) const;
+
+  static interval entire();
+  static interval add(const interval& a, const interval& b);
+  static interval subtract(const interval& a, const interval& b);
+  static interval multiply(const interval& a, const interval& b);
+  static interval divide(const interval& a, const interval& b);
+  static interval power(const interval& a, const interval& b);
+  static interval function(unsigned int op, const interval& a); //negation and all functions of operators::ops
+  static interval compare(unsigned int op, const interval& a, const interval& b); //comparisons and logical operators, [0,1] if undecided
+  static interval hull(const interval& a, const interval& b);
+
+  double lower;
+  double upper;
+
+private:
+  static interval widen(double l, double u);
+  static bool hits(double l, double u, double offset, double period);
+  static interval trig(const interval& a, bool cosine);
+  static interval tan(const interval& a);
+  static interval integerPower(const interval& a, double n);
+};
+
+#endif //INTERVAL_H
@@ -0,0 +1,214 @@
+/***********************************************************/
+/*              library class implementation               */
+/***********************************************************/
+
+#include "library.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const uint32_t byteOrderMark = 0x01020304;
+
+struct branch {
+  uint32_t elseAt; //first instruction of the second branch
+  uint32_t end;    //instruction after the second branch, 0 until the jump ending the first branch was seen
+  size_t depth;    //stack depth before the first branch
+};
+
+library::library() : p_data(0), p_length(0) {
+  close();
+}
+
+library::~library() {
+  close();
+}
+
+//write programs to path, the file can be loaded by load() on machines with the same byte order
+bool library::save(const string& path, const vector<program>& programs) {
+  header h;
+  memset(&h,0,sizeof(h));
+  memcpy(h.magic,"CALC",4);
+  h.version = version;
+  h.byteOrder = byteOrderMark;
+  h.count = programs.size();
+  vector<entry> entries(programs.size());
+  uint32_t offset = 0;
+  for(size_t n = 0; n < programs.size(); n++) {
+    entries[n].offset = offset;
+    entries[n].size = programs[n].size();
+    entries[n].variables = programs[n].variableCount();
+    entries[n].depth = programs[n].depth();
+    offset += entries[n].size;
+    if( entries[n].variables > h.variables )
+      h.variables = entries[n].variables;
+  }
+
+  FILE *file = fopen(path.c_str(),"wb");
+  if( !file ) {
+    p_errorstring = "unable to create "+path;
+    return false;
+  }
+  bool ok = fwrite(&h,sizeof(h),1,file) == 1;
+  if( ok && !entries.empty() )
+    ok = fwrite(&entries[0],sizeof(entry),entries.size(),file) == entries.size();
+  for(size_t n = 0; ok && n < programs.size(); n++)
+    ok = fwrite(programs[n].code(),sizeof(program::instruction),programs[n].size(),file) == programs[n].size();
+  if( fclose(file) != 0 || !ok ) {
+    p_errorstring = "unable to write "+path;
+    return false;
+  }
+  return true;
+}
+
+//map path into memory, programs handed out by get() refer to it until close() is called
+bool library::load(const string& path) {
+  close();
+  int fd = open(path.c_str(),O_RDONLY);
+  if( fd < 0 ) {
+    p_errorstring = "unable to open "+path;
+    return false;
+  }
+  struct stat st;
+  if( fstat(fd,&st) != 0 || st.st_size < (off_t)sizeof(header) ) {
+    ::close(fd);
+    p_errorstring = path+" is no expression library";
+    return false;
+  }
+  p_length = st.st_size;
+  p_data = mmap(0,p_length,PROT_READ,MAP_PRIVATE,fd,0);
+  ::close(fd);
+  if( p_data == MAP_FAILED ) {
+    p_data = 0;
+    p_errorstring = "unable to map "+path;
+    return false;
+  }
+  if( !verify() ) {
+    string error = p_errorstring;
+    close();
+    p_errorstring = path+": "+error;
+    return false;
+  }
+  return true;
+}
+
+void library::close() {
+  if( p_data )
+    munmap(p_data,p_length);
+  p_data = 0;
+  p_length = 0;
+  p_header = 0;
+  p_entries = 0;
+  p_code = 0;
+  p_codeSize = 0;
+}
+
+size_t library::size() const {
+  return p_header ? p_header->count : 0;
+}
+
+unsigned int library::variableCount() const {
+  return p_header ? p_header->variables : 0;
+}
+
+//let prog refer to expression index
+bool library::get(size_t index, program& prog) const {
+  if( index >= size() )
+    return false;
+  const entry &e = p_entries[index];
+  prog.assign(p_code+e.offset,e.size,e.variables,e.depth);
+  return true;
+}
+
+string library::getError() {
+  return p_errorstring;
+}
+
+//check the mapped file, so evaluating its programs can neither read nor write out of bounds
+bool library::verify() {
+  const header *h = (const header*)p_data;
+  if( memcmp(h->magic,"CALC",4) != 0 ) {
+    p_errorstring = "no expression library";
+    return false;
+  }
+  if( h->byteOrder != byteOrderMark ) {
+    p_errorstring = "written on a machine with different byte order";
+    return false;
+  }
+  if( h->version != version ) {
+    p_errorstring = "unsupported version";
+    return false;
+  }
+  size_t codeStart = sizeof(header)+(size_t)h->count*sizeof(entry);
+  if( codeStart > p_length || (p_length-codeStart)%sizeof(program::instruction) != 0 ) {
+    p_errorstring = "truncated file";
+    return false;
+  }
+  const entry *entries = (const entry*)((const char*)p_data+sizeof(header));
+  const program::instruction *code = (const program::instruction*)((const char*)p_data+codeStart);
+  size_t codeSize = (p_length-codeStart)/sizeof(program::instruction);
+
+  for(uint32_t n = 0; n < h->count; n++) {
+    const entry &e = entries[n];
+    //every instruction pushes at most one value, so a larger depth can only be meant to make evaluate() allocate too much
+    if( e.size == 0 || e.offset > codeSize || e.size > codeSize-e.offset || e.variables > h->variables || e.depth == 0 || e.depth > e.size ) {
+      p_errorstring = "corrupt expression entry";
+      return false;
+    }
+    //conditionals have to be nested properly (see program.h), the depth is simulated as if both branches of each ran like in blocks
+    vector<branch> open;
+    size_t depth = 0;
+    bool valid = true;
+    for(uint32_t pc = 0; valid && pc <= e.size; pc++) {
+      while( valid && !open.empty() && open.back().end == pc ) { //second branch complete, both results get blended
+        valid = depth == open.back().depth+2;
+        depth--;
+        open.pop_back();
+      }
+      if( !valid || pc == e.size )
+        break;
+      const program::instruction *it = code+e.offset+pc;
+      if( !open.empty() && open.back().end == 0 && open.back().elseAt == pc ) { //first branch did not end with a jump
+        valid = false;
+        break;
+      }
+      if( it->op == operators::none || it->op == operators::variable ) {
+        valid = it->op == operators::none || it->slot < e.variables;
+        depth++;
+      }
+      else if( it->op == operators::jumpUnless ) {
+        uint32_t limit = open.empty() ? e.size : (open.back().end ? open.back().end : open.back().elseAt-1);
+        valid = depth >= 1 && it->slot > pc+1 && it->slot < limit;
+        branch b = { it->slot, 0, --depth };
+        open.push_back(b);
+      }
+      else if( it->op == operators::jump ) {
+        valid = !open.empty() && open.back().end == 0 && open.back().elseAt == pc+1 && depth == open.back().depth+1 && it->slot > pc+1;
+        if( valid ) {
+          open.back().end = it->slot;
+          valid = open.size() == 1 ? it->slot <= e.size : it->slot <= (open[open.size()-2].end ? open[open.size()-2].end : open[open.size()-2].elseAt-1);
+        }
+      }
+      else if( it->op > operators::bracketCount && it->op < operators::negation ) {
+        valid = depth >= 2;
+        depth--;
+      }
+      else
+        valid = depth >= 1 && (it->op == operators::negation || (it->op > operators::operatorCount && it->op < operators::functionCount && it->op != operators::conditional));
+      valid = valid && depth <= e.depth;
+    }
+    valid = valid && open.empty();
+    if( !valid || depth != 1 ) {
+      p_errorstring = "corrupt expression code";
+      return false;
+    }
+  }
+  p_header = h;
+  p_entries = entries;
+  p_code = code;
+  p_codeSize = codeSize;
+  return true;
+}
@@ -0,0 +1,64 @@
+/***********************************************************/
+/*                    library class                        */
+/* File of precompiled expressions. load() maps the file   */
+/* into memory, get() hands out programs referring to the  */
+/* mapped instructions, so nothing is parsed or copied.    */
+/*                                                         */
+/* File layout (native byte order, checked on load):       */
+/*   header                                                */
+/*   entry[count]              one per expression          */
+/*   program::instruction[]    code of all expressions     */
+/***********************************************************/
+
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "program.h"
+
+using namespace std;
+
+class library {
+public:
+  static const uint32_t version = 3; //2: vector operators and reductions renumbered the opcodes, 3: comparisons and jumps
+
+  library();
+  ~library();
+  bool save(const string& path, const vector<program>& programs);
+  bool load(const string& path);
+  void close();
+  size_t size() const;
+  unsigned int variableCount() const;
+  bool get(size_t index, program& prog) const;
+  string getError();
+
+private:
+  struct header {
+    char magic[4];       //"CALC"
+    uint32_t version;
+    uint32_t byteOrder;  //0x01020304 as written by the creating machine
+    uint32_t count;      //number of expressions
+    uint32_t variables;  //number of variable slots used by any expression
+    uint32_t reserved[3];
+  };
+  struct entry {
+    uint32_t offset;     //first instruction, counted from the start of the code section
+    uint32_t size;       //number of instructions
+    uint32_t variables;
+    uint32_t depth;      //stack depth needed to evaluate
+  };
+  bool verify();
+
+  void *p_data;
+  size_t p_length;
+  const header *p_header;
+  const entry *p_entries;
+  const program::instruction *p_code;
+  size_t p_codeSize;
+  string p_errorstring;
+};
+
+#endif //LIBRARY_H
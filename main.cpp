@@ -1,7 +1,153 @@
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <unistd.h>
+#include <csignal>
+#include <atomic>
+
 #include "interface.h"
+#include "metrics.h"
+#include "summary.h"
+#include "input.h"
+
+void usage(const char *name) {
+  cerr << "Usage: " << name << " [--batch] [--binary] [--aggregate] [--histogram lower,upper,bins] [--compile file [--variables x,y,...]] [--load file] [--table file --expression text] [--shm name] [--watch file] [--stream] [--timeout ms] [--stats]" << endl;
+  cerr << "  --batch      evaluate one expression per line of stdin (default if stdin is no terminal)" << endl;
+  cerr << "  --binary     like --batch, but write each result as a 16 byte record: little-endian double, status byte," << endl;
+  cerr << "               kind byte (0 scalar, 1 bound, 2 vector), 2 zero bytes and a little-endian 32 bit count" << endl;
+  cerr << "               of scalar records following (lower and upper bound, vector elements)" << endl;
+  cerr << "  --aggregate  like --batch, but only print count, sum, mean, min, max and errors of all results" << endl;
+  cerr << "  --histogram  like --aggregate, additionally count results in equally wide bins of [lower,upper)" << endl;
+  cerr << "  --compile    compile one expression per line of stdin into an expression library file" << endl;
+  cerr << "  --variables  comma separated variable names usable in compiled expressions. Their values are scalars," << endl;
+  cerr << "               vectors ([1,2,3], ans) are only available in the batch and interactive modes" << endl;
+  cerr << "  --load       evaluate all expressions of a library file, reading one line of variable values" << endl;
+  cerr << "               per evaluation from stdin if they use variables" << endl;
+  cerr << "  --table      evaluate the expression given with --expression for every row of a CSV file whose first" << endl;
+  cerr << "               line names the columns, or of a raw columnar binary file of doubles if --variables" << endl;
+  cerr << "               names its columns. Prints one result per row" << endl;
+  cerr << "  --shm        answer requests of producers on this host through the shared memory channel name," << endl;
+  cerr << "               entry requests refer to the library given with --load (see channel.h)" << endl;
+  cerr << "  --watch      evaluate one expression per line of file, then again whenever it is saved, printing" << endl;
+  cerr << "               changed results as a diff. Only edited lines (and lines using a changed ans) are evaluated" << endl;
+  cerr << "  --stream     evaluate all of stdin as one expression, read in chunks (for huge expressions)" << endl;
+  cerr << "  --timeout    give up evaluating a line, request, table or stream after ms milliseconds" << endl;
+  cerr << "               (shm requests may set their own limit). The first Ctrl-C cancels running evaluations" << endl;
+  cerr << "               and stops reading input, the second one terminates" << endl;
+  cerr << "  --stats      write parser statistics as JSON to stderr when done" << endl;
+}
+
+static atomic<bool> interrupted(false);
+
+//first SIGINT cancels, the default action of the next one terminates
+extern "C" void interrupt(int) {
+  interrupted.store(true,memory_order_relaxed);
+  signal(SIGINT,SIG_DFL);
+}
+
+//without SA_RESTART, reads waiting for input fail with EINTR, so the modes reading stdin notice the cancellation at once
+static void catchInterrupt() {
+  struct sigaction action;
+  memset(&action,0,sizeof(action));
+  action.sa_handler = interrupt;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT,&action,0);
+}
 
 //Main function 
-int main() {
+int main(int argc, char *argv[]) {
+  bool batch = !isatty(STDIN_FILENO), binary = false, stats = false, stream = false, aggregate = false;
+  summary prototype;
+  uint64_t timeout = 0;
+  string compileFile, loadFile, shmName, tableFile, expression, watchFile;
+  vector<string> variables;
+  for(int n = 1; n < argc; n++) {
+    if( !strcmp(argv[n],"--batch") )
+      batch = true;
+    else if( !strcmp(argv[n],"--binary") )
+      batch = binary = true;
+    else if( !strcmp(argv[n],"--aggregate") )
+      aggregate = true;
+    else if( !strcmp(argv[n],"--histogram") && n+1 < argc ) {
+      double lower, upper;
+      unsigned int bins;
+      char separator1, separator2;
+      istringstream settings(argv[++n]);
+      if( !(settings >> lower >> separator1 >> upper >> separator2 >> bins) || separator1 != ',' || separator2 != ',' || !(lower < upper) || bins == 0 ) {
+        usage(argv[0]);
+        return 1;
+      }
+      prototype.setHistogram(lower,upper,bins);
+      aggregate = true;
+    }
+    else if( !strcmp(argv[n],"--stream") )
+      stream = true;
+    else if( !strcmp(argv[n],"--timeout") && n+1 < argc ) {
+      double milliseconds;
+      istringstream setting(argv[++n]);
+      if( !(setting >> milliseconds) || !(milliseconds > 0) ) {
+        usage(argv[0]);
+        return 1;
+      }
+      timeout = milliseconds*1e6;
+    }
+    else if( !strcmp(argv[n],"--stats") )
+      stats = true;
+    else if( !strcmp(argv[n],"--compile") && n+1 < argc )
+      compileFile = argv[++n];
+    else if( !strcmp(argv[n],"--load") && n+1 < argc )
+      loadFile = argv[++n];
+    else if( !strcmp(argv[n],"--table") && n+1 < argc )
+      tableFile = argv[++n];
+    else if( !strcmp(argv[n],"--expression") && n+1 < argc )
+      expression = argv[++n];
+    else if( !strcmp(argv[n],"--shm") && n+1 < argc )
+      shmName = argv[++n];
+    else if( !strcmp(argv[n],"--watch") && n+1 < argc )
+      watchFile = argv[++n];
+    else if( !strcmp(argv[n],"--variables") && n+1 < argc ) {
+      istringstream names(argv[++n]);
+      string name;
+      while( getline(names,name,',') )
+        variables.push_back(name);
+    }
+    else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if( tableFile.empty() != expression.empty() ) {
+    usage(argv[0]);
+    return 1;
+  }
   interface i;
-  return i.talk();
+  i.setTimeLimit(timeout);
+  if( batch || aggregate || stream || !tableFile.empty() || !shmName.empty() || !loadFile.empty() || !watchFile.empty() ) { //the interactive mode keeps Ctrl-C as is
+    i.setCancelToken(&interrupted);
+    catchInterrupt();
+  }
+  input stdinBuffer(STDIN_FILENO); //unlike cin, stops reading when interrupted
+  istream in(&stdinBuffer);
+  int result;
+  if( !compileFile.empty() )
+    result = i.compileLibrary(in,compileFile,variables);
+  else if( !tableFile.empty() )
+    result = i.evaluateTable(tableFile,variables,expression,binary);
+  else if( !shmName.empty() )
+    result = i.serve(shmName,loadFile);
+  else if( !watchFile.empty() )
+    result = i.watch(watchFile);
+  else if( !loadFile.empty() )
+    result = i.runLibrary(loadFile,in,binary);
+  else if( aggregate )
+    result = i.aggregate(in,prototype);
+  else if( stream )
+    result = i.stream(in,binary);
+  else if( batch )
+    result = i.batch(in,binary);
+  else
+    result = i.talk();
+  if( stats )
+    cerr << metrics::json() << endl;
+  return result;
 }
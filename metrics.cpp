@@ -0,0 +1,212 @@
+/***********************************************************/
+/*              metrics class implementation               */
+/***********************************************************/
+
+#include "metrics.h"
+
+#include <sstream>
+#include <cstring>
+#include <mutex>
+
+static mutex listLock;               //guards blocks and finished, counting itself takes no lock
+static void *blocks = 0;             //blocks of all running threads that counted
+static metrics::counters finished;   //totals of threads that ended
+static thread_local void *ownBlock = 0;
+
+//returns the block of the calling thread, creating and registering it on first use
+metrics::block* metrics::local() {
+  if( !ownBlock ) {
+    block *b = new block();
+    {
+      lock_guard<mutex> lock(listLock);
+      b->next = (block*)blocks;
+      blocks = b;
+    }
+    ownBlock = b;
+    static thread_local exitHook hook; //destroyed when the thread ends
+    (void)hook;
+  }
+  return (block*)ownBlock;
+}
+
+metrics::exitHook::~exitHook() {
+  block *own = (block*)ownBlock;
+  lock_guard<mutex> lock(listLock);
+  sum(finished,own);
+  for(block **b = (block**)&blocks; *b; b = &(*b)->next)
+    if( *b == own ) {
+      *b = own->next;
+      break;
+    }
+  delete own;
+  ownBlock = 0;
+}
+
+void metrics::expression(parser::state state) {
+  block *b = local();
+  add(b->expressions,1);
+  if( state < stateCount )
+    add(b->states[state],1);
+}
+
+//points evaluated by a compiled program at once, failed evaluations count as a result with their state
+void metrics::evaluated(parser::state state, uint64_t points) {
+  block *b = local();
+  add(b->points,points);
+  if( state != parser::complete && state < stateCount )
+    add(b->states[state],1);
+}
+
+void metrics::time(phase p, uint64_t nanoseconds) {
+  block *b = local();
+  int bucket = 0;
+  while( bucket < bucketCount-1 && nanoseconds >> (bucket+1) )
+    bucket++;
+  add(b->histogram[p][bucket],1);
+  add(b->nanoseconds[p],nanoseconds);
+}
+
+//sum of the counters of all threads
+metrics::counters metrics::collect() {
+  lock_guard<mutex> lock(listLock);
+  counters c = finished;
+  for(block *b = (block*)blocks; b; b = b->next)
+    sum(c,b);
+  return c;
+}
+
+void metrics::sum(counters &c, const block *b) {
+  c.expressions += b->expressions.load(memory_order_relaxed);
+  c.tokens += b->tokens.load(memory_order_relaxed);
+  c.points += b->points.load(memory_order_relaxed);
+  for(int n = 0; n < operators::constantCount; n++)
+    c.operators[n] += b->operators[n].load(memory_order_relaxed);
+  for(int n = 0; n < stateCount; n++)
+    c.states[n] += b->states[n].load(memory_order_relaxed);
+  for(int p = 0; p < phaseCount; p++) {
+    c.nanoseconds[p] += b->nanoseconds[p].load(memory_order_relaxed);
+    for(int n = 0; n < bucketCount; n++)
+      c.histogram[p][n] += b->histogram[p][n].load(memory_order_relaxed);
+  }
+}
+
+//human readable summary for the stats command
+string metrics::report() {
+  static const char *phases[phaseCount] = { "lex", "evaluate", "format", "run" };
+  counters c = collect();
+  ostringstream out;
+  out << "expressions: " << c.expressions << ", tokens: " << c.tokens << ", compiled points: " << c.points << endl;
+  out << "results:";
+  for(int n = 0; n < stateCount; n++)
+    if( c.states[n] )
+      out << " " << name((parser::state)n) << "=" << c.states[n];
+  out << endl << "operators:";
+  for(int n = 0; n < operators::constantCount; n++)
+    if( c.operators[n] && name(n) )
+      out << " " << name(n) << "=" << c.operators[n];
+  out << endl;
+  for(int p = 0; p < phaseCount; p++) {
+    uint64_t count = 0;
+    for(int n = 0; n < bucketCount; n++)
+      count += c.histogram[p][n];
+    out << phases[p] << ": " << count << " samples";
+    if( count )
+      out << ", mean " << c.nanoseconds[p]/count << "ns, p50 < " << percentile(c.histogram[p],0.5) << "ns, p99 < " << percentile(c.histogram[p],0.99) << "ns";
+    out << endl;
+  }
+  return out.str();
+}
+
+//all counters as JSON object, histogram buckets are listed as upper bound in nanoseconds and count
+string metrics::json() {
+  static const char *phases[phaseCount] = { "lex", "evaluate", "format", "run" };
+  counters c = collect();
+  ostringstream out;
+  out << "{\"expressions\":" << c.expressions << ",\"tokens\":" << c.tokens << ",\"points\":" << c.points << ",\"states\":{";
+  for(int n = 0; n < stateCount; n++)
+    out << (n ? "," : "") << "\"" << name((parser::state)n) << "\":" << c.states[n];
+  out << "},\"operators\":{";
+  bool first = true;
+  for(int n = 0; n < operators::constantCount; n++)
+    if( name(n) ) {
+      out << (first ? "" : ",") << "\"" << name(n) << "\":" << c.operators[n];
+      first = false;
+    }
+  out << "},\"latency\":{";
+  for(int p = 0; p < phaseCount; p++) {
+    out << (p ? "," : "") << "\"" << phases[p] << "\":{\"total_ns\":" << c.nanoseconds[p] << ",\"buckets\":[";
+    first = true;
+    for(int n = 0; n < bucketCount; n++)
+      if( c.histogram[p][n] ) {
+        out << (first ? "" : ",") << "[" << (uint64_t(2) << n) << "," << c.histogram[p][n] << "]";
+        first = false;
+      }
+    out << "]}";
+  }
+  out << "}}";
+  return out.str();
+}
+
+//upper bound of the bucket containing the given fraction of all samples
+uint64_t metrics::percentile(const uint64_t *histogram, double fraction) {
+  uint64_t count = 0, seen = 0;
+  for(int n = 0; n < bucketCount; n++)
+    count += histogram[n];
+  for(int n = 0; n < bucketCount; n++) {
+    seen += histogram[n];
+    if( seen >= fraction*count )
+      return uint64_t(2) << n;
+  }
+  return uint64_t(2) << (bucketCount-1);
+}
+
+const char* metrics::name(int op) {
+  switch( op ) {
+    case operators::logicalOr    : return "or";
+    case operators::logicalAnd   : return "and";
+    case operators::equal        : return "equal";
+    case operators::notEqual     : return "notEqual";
+    case operators::less         : return "less";
+    case operators::lessEqual    : return "lessEqual";
+    case operators::greater      : return "greater";
+    case operators::greaterEqual : return "greaterEqual";
+    case operators::plus         : return "plus";
+    case operators::minus        : return "minus";
+    case operators::times        : return "times";
+    case operators::divide       : return "divide";
+    case operators::pow          : return "pow";
+    case operators::negation     : return "negation";
+    case operators::sin          : return "sin";
+    case operators::cos          : return "cos";
+    case operators::tan          : return "tan";
+    case operators::arcsin       : return "arcsin";
+    case operators::arccos       : return "arccos";
+    case operators::arctan       : return "arctan";
+    case operators::sqrt         : return "sqrt";
+    case operators::abs          : return "abs";
+    case operators::sum          : return "sum";
+    case operators::mean         : return "mean";
+    case operators::min          : return "min";
+    case operators::max          : return "max";
+    case operators::dot          : return "dot";
+    case operators::conditional  : return "if";
+    case operators::pi           : return "pi";
+    case operators::e            : return "e";
+    case operators::ans          : return "ans";
+    case operators::variable     : return "variable";
+  }
+  return 0; //brackets and counters
+}
+
+const char* metrics::name(parser::state state) {
+  switch( state ) {
+    case parser::running       : return "running";
+    case parser::complete      : return "complete";
+    case parser::syntaxerror   : return "syntaxerror";
+    case parser::matherror     : return "matherror";
+    case parser::internalerror : return "internalerror";
+    case parser::timeout       : return "timeout";
+    case parser::cancelled     : return "cancelled";
+  }
+  return "unknown";
+}
@@ -0,0 +1,89 @@
+/***********************************************************/
+/*                    metrics class                        */
+/* Always-on counters and latency histograms. Every thread */
+/* writes to its own block, so counting needs neither      */
+/* locks nor atomic read-modify-write operations. Reading  */
+/* sums up the blocks of all running threads and the       */
+/* totals of finished ones. Latencies are sampled, reading */
+/* the clock costs about as much as evaluating a token.    */
+/***********************************************************/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+#include "parser.h"
+
+using namespace std;
+
+class metrics {
+public:
+  enum phase { lex, evaluate, format, run, phaseCount }; //run: compiled programs
+  static const int stateCount = parser::cancelled+1;
+  static const int bucketCount = 32; //bucket n counts durations of [2^n,2^(n+1)) nanoseconds
+
+  struct counters {
+    uint64_t expressions;
+    uint64_t tokens;
+    uint64_t points;   //variable values compiled programs were evaluated for
+    uint64_t operators[operators::constantCount];
+    uint64_t states[stateCount];
+    uint64_t histogram[phaseCount][bucketCount];
+    uint64_t nanoseconds[phaseCount];
+  };
+
+  static void expression(parser::state state);
+  static void token();
+  static void operation(operators::ops op);
+  static void time(phase p, uint64_t nanoseconds);
+  static void evaluated(parser::state state, uint64_t points);
+  static uint64_t now();
+
+  static counters collect();
+  static string report();
+  static string json();
+  static const char* name(parser::state state);
+
+private:
+  struct block {
+    atomic<uint64_t> expressions;
+    atomic<uint64_t> tokens;
+    atomic<uint64_t> points;
+    atomic<uint64_t> operators[operators::constantCount];
+    atomic<uint64_t> states[stateCount];
+    atomic<uint64_t> histogram[phaseCount][bucketCount];
+    atomic<uint64_t> nanoseconds[phaseCount];
+    block *next;
+  };
+  struct exitHook { //merges the block of a finished thread into the totals, so threads don't leak blocks
+    ~exitHook();
+  };
+  static block* local();
+  static void sum(counters &c, const block *b);
+  static void add(atomic<uint64_t> &counter, uint64_t value);
+  static uint64_t percentile(const uint64_t *histogram, double fraction);
+  static const char* name(int op);
+};
+
+//only the owning thread writes a counter, so a relaxed load and store is enough and much cheaper than fetch_add
+inline void metrics::add(atomic<uint64_t> &counter, uint64_t value) {
+  counter.store(counter.load(memory_order_relaxed)+value,memory_order_relaxed);
+}
+
+inline void metrics::token() {
+  add(local()->tokens,1);
+}
+
+inline void metrics::operation(operators::ops op) {
+  add(local()->operators[op],1);
+}
+
+inline uint64_t metrics::now() {
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif //METRICS_H
@@ -5,11 +5,15 @@
 /***********************************************************/
 
 #include "parser.h"
+#include "program.h"
+#include "metrics.h"
 
 #include <sstream>
 #include <iostream>
 #include <cmath>
 #include <limits>
+#include <charconv>
+#include <cctype>
 
 //If the local implementation defines M_PI, use it, but if its missing due to it's not being standard, push our hardcoded pi
 #ifdef M_PI	
@@ -24,7 +28,7 @@
   const double LE = 2.71828;
 #endif
 
-parser::parser() : p_debug(false), p_ans(numeric_limits<double>::quiet_NaN()) {
+parser::parser() : p_program(0), p_ans(numeric_limits<double>::quiet_NaN()), p_debug(false), p_deadline(0), p_steps(0), p_expressions(0) {
   clear();
 
   //Initialize operator map
@@ -59,369 +63,650 @@ parser::parser() : p_debug(false), p_ans(numeric_limits<double>::quiet_NaN()) {
   p_opmap["ABS"] = operators::abs;
   p_opmap["("] = operators::lbracket;
   p_opmap[")"] = operators::rbracket;
+  p_opmap["["] = operators::lvector;
+  p_opmap["]"] = operators::rvector;
+  p_opmap[","] = operators::comma;
+  p_opmap["sum"] = operators::sum;
+  p_opmap["SUM"] = operators::sum;
+  p_opmap["mean"] = operators::mean;
+  p_opmap["MEAN"] = operators::mean;
+  p_opmap["min"] = operators::min;
+  p_opmap["MIN"] = operators::min;
+  p_opmap["max"] = operators::max;
+  p_opmap["MAX"] = operators::max;
+  p_opmap["dot"] = operators::dot;
+  p_opmap["DOT"] = operators::dot;
+  p_opmap["=="] = operators::equal;
+  p_opmap["!="] = operators::notEqual;
+  p_opmap["<"] = operators::less;
+  p_opmap["<="] = operators::lessEqual;
+  p_opmap[">"] = operators::greater;
+  p_opmap[">="] = operators::greaterEqual;
+  p_opmap["and"] = operators::logicalAnd;
+  p_opmap["AND"] = operators::logicalAnd;
+  p_opmap["&&"] = operators::logicalAnd;
+  p_opmap["or"] = operators::logicalOr;
+  p_opmap["OR"] = operators::logicalOr;
+  p_opmap["||"] = operators::logicalOr;
+  p_opmap["if"] = operators::conditional;
+  p_opmap["IF"] = operators::conditional;
   p_opmap["pi"] = operators::pi;
   p_opmap["Pi"] = operators::pi;
   p_opmap["PI"] = operators::pi;
   p_opmap["e"] = operators::e; //note that "2e+4" is "2*e+4" while "2E+4" is "2*10^4"
   p_opmap["negation"] = operators::negation; //map negation, may be used in formula but mainly useful for debugging output (reverse lookup)
+
+  p_tokenLength = 0;
+  for(map<string,operators::ops>::iterator it = p_opmap.begin(); it != p_opmap.end(); it++)
+    if( it->first.length() > p_tokenLength )
+      p_tokenLength = it->first.length();
 }
 
-//parse expression
+//parse expression at once, see feed() for expressions that don't fit into memory
 parser::state parser::parse(const string& expression) {
-  debug("parse() initializing to parse "+expression);
+  begin();
+  feed(expression);
+  finish();
+  p_expression = expression; //p_expression only holds unprocessed input, save the expression for our getError() method
+  return p_state;
+}
+
+//prepare parsing a new expression that is passed in chunks to feed()
+void parser::begin() {
   if( !p_numbers.empty() )
     p_ans = p_numbers.top();
   clear(); //make sure no data from previous parsing is left
   p_state = running;
-  p_expression = expression; //we won't modify expression
+  p_needOperator = false;
+  p_lexTime = 0;
+  p_busyTime = 0;
+  p_sampled = p_expressions++%sampleRate == 0;
+  p_steps = 0;
+}
+
+//process the next part of the expression. Tokens may be split between chunks, anything that could continue in the next chunk is kept until then
+parser::state parser::feed(const string& chunk) {
+  uint64_t start = p_sampled ? metrics::now() : 0;
+  if( p_state == running ) {
+    debug("feed() "+chunk);
+    p_expression.reserve(p_expression.length()+chunk.length());
+    for(string::const_iterator it = chunk.begin(); it != chunk.end(); it++)
+      if( *it != ' ' && *it != '\t' && *it != '\r' && *it != '\n' )
+        p_expression += *it;
+    tokenize(false);
+  }
+  if( p_sampled )
+    p_busyTime += metrics::now()-start;
+  return p_state;
+}
+
+//no more input, process what is left and compute the result. Time spent in the lexer and in evaluation is recorded by metrics
+//for every sampleRate-th expression, reading the clock for every token would cost more than lexing it
+parser::state parser::finish() {
+  uint64_t start = p_sampled ? metrics::now() : 0;
+  if( p_state == running )
+    tokenize(true);
+  debug("finish() computing remaining operators/numbers");
+
+  //a missing ) is tolerated elsewhere, but if(c,a,b) only knows where its branches end at its )
+  if( p_state == running && !p_conditionals.empty() ) {
+    p_errorstring = "Missing right parenthese of if";
+    p_state = syntaxerror;
+  }
+
+  //Expression is parsed, we now just have to process all remaining operators
+  while( p_state == running && !p_operators.empty() && !expired() )
+    processOperator();
+
+  if( p_state == running && !p_operators.empty() && !p_numbers.empty() && p_numbers.size() > 1 ) {
+    p_errorstring = "Too few operators!";
+    p_state = syntaxerror;
+  }
+
+  if( p_state == running )
+    p_state = complete;
+  if( p_sampled ) {
+    p_busyTime += metrics::now()-start;
+    metrics::time(metrics::lex,p_lexTime);
+    metrics::time(metrics::evaluate,p_busyTime-p_lexTime);
+  }
+  metrics::expression(p_state);
+  return p_state;
+}
+
+//Shunting-yard algorithm, processes all complete tokens of p_expression. Unless final is set, a token reaching the end of p_expression is left for later
+void parser::tokenize(bool final) {
   double temp;
   operators::ops op;
-  bool needoperator = false; //the needoperator value helps deciding between +/- signs or operators ( and to process "missing" *'s)
 
-  //Shunting-yard algorithm
-  while( p_state == running && !p_expression.empty() ) { //process p_expression until it is empty or we encouter a p_state change
-    debug("parse() parsing expression "+p_expression+(needoperator ? " need operator" : " dont need operator"));
+  while( p_state == running && p_position < p_expression.length() && !expired() ) { //process p_expression until it is empty or we encouter a p_state change
+    if( p_debug )
+      debug("parse() parsing expression "+p_expression.substr(p_position)+(p_needOperator ? " need operator" : " dont need operator"));
     //Process input
-    if( !needoperator && extractNumber(temp) ) { //we won't try to read two numbers in a row (!needoperator), if extractNumber fails, try to exractOperator
-      if( !p_operators.empty() && p_operators.top() > operators::operatorCount && p_operators.top() != operators::rbracket ) {
+    lexed number = p_needOperator ? notFound : extractNumber(temp,final); //we won't try to read two numbers in a row (!needoperator), if extractNumber fails, try to exractOperator
+    if( number == needInput )
+      break;
+    if( number == found ) {
+      if( !p_operators.empty() && p_operators.top() > operators::operatorCount ) {
         debug("parse() missing operator before %v1",temp);
-        p_errorstring = "missing operator at "+p_expression;
+        p_errorstring = "missing operator at "+p_expression.substr(p_position);
         p_state = syntaxerror;
-        return p_state;
+        return;
       }
       p_numbers.push(temp);
-      needoperator = true;
-      debug("parse() found number %v1",p_numbers.top());
+      if( p_program )
+        p_program->push(temp);
+      p_needOperator = true;
+      debug("parse() found number %v1",p_numbers.top().scalar());
     }
     else { //BEGIN OPERATOR HANDLING (this will be nasty)
-      if( extractOperator(op) ) {
+      lexed result = extractOperator(op,final);
+      if( result == needInput )
+        break;
+      if( result == found ) {
         //Handle negation
-        if( !needoperator && op == operators::minus )
+        if( !p_needOperator && op == operators::minus )
           op = operators::negation;
 
         //Process operators with higher priority, parentheses need special care
-        while( p_state == running && !p_operators.empty() && op > operators::bracketCount && p_operators.top() >= op ) {
+        while( p_state == running && !p_operators.empty() && op > operators::bracketCount && precedence(p_operators.top()) >= precedence(op) ) {
           debug("parse() preferring operator %o1 over %o2",p_operators.top(),op);
           processOperator();
         }
 
         //if processOperator encountered an error, return
         if( p_state != running )
-          return p_state;
+          return;
 
-        //prepend operators::times to functions and parentheses where it is left out
-        if( (op > operators::operatorCount || op == operators::lbracket) && needoperator ) {
+        //prepend operators::times to functions, parentheses and vectors where it is left out
+        if( (op > operators::operatorCount || op == operators::lbracket || op == operators::lvector) && p_needOperator ) {
           debug("parse() function without preceeding operator, inserting operator %o1",operators::times);
           p_operators.push(operators::times);
         }
 
-        //push operator on stack
-        p_operators.push(op);
-        debug("parse() operator %o1 found",p_operators.top());
-
         //Constants are just being replaced, so we still need an operator!
-        if( op > operators::functionCount || op == operators::rbracket )
-          needoperator = true;
+        if( op > operators::functionCount || op == operators::rbracket || op == operators::rvector )
+          p_needOperator = true;
         else
-          needoperator = false;
+          p_needOperator = false;
 
-        //Process parentheses
+        //Process parentheses, vectors and argument separators
         if( op == operators::rbracket ) {
-          processOperator();
-          if( !p_operators.empty() && p_operators.top() > operators::operatorCount && p_operators.top() < operators::functionCount ) {
-            debug("parse() rbracket belongs to operator %o1, calculating...",p_operators.top());
-            processOperator();
+          debug("parse() operator %o1 found",op);
+          closeBracket();
+        }
+        else if( op == operators::rvector ) {
+          debug("parse() operator %o1 found",op);
+          closeVector();
+        }
+        else if( op == operators::comma )
+          nextArgument();
+        else { //push operator on stack
+          bool opensIf = op == operators::lbracket && !p_operators.empty() && p_operators.top() == operators::conditional;
+          p_operators.push(op);
+          if( opensIf ) {
+            struct ifBracket c = { p_operators.size(), 0, 0 };
+            p_conditionals.push(c);
+          }
+          //a false left side of and (true one of or) decides the result, the right side is skipped
+          if( (op == operators::logicalAnd || op == operators::logicalOr) && !p_skip && !p_program && !p_numbers.empty() && !p_numbers.top().isVector()
+              && value::truth(p_numbers.top().scalar()) == (op == operators::logicalOr) )
+            p_skip = p_operators.size();
+          //compiled programs decide while running: a and b is recorded as if(a,1 and b,0), a or b as if(a,1,0 or b)
+          if( (op == operators::logicalAnd || op == operators::logicalOr) && p_program ) {
+            size_t jumpAt = p_program->jump(operators::jumpUnless);
+            p_program->push(1);
+            if( op == operators::logicalOr ) {
+              size_t endAt = p_program->jump(operators::jump);
+              p_program->target(jumpAt);
+              p_program->push(0);
+              jumpAt = endAt;
+            }
+            p_shortCircuits.push(jumpAt);
+            p_guarded++;
           }
+          if( op == operators::variable )
+            p_slots.push(p_foundSlot);
+          if( op == operators::lbracket || op == operators::lvector )
+            p_commas.push(0);
+          if( op == operators::lvector )
+            p_vectorStarts.push(p_numbers.size());
+          debug("parse() operator %o1 found",p_operators.top());
         }
       }
       else { //extractOperator was unable to process p_expression
         p_state = syntaxerror;
-        p_errorstring = "unable to parse " + p_expression;
-        return p_state;
+        p_errorstring = "unable to parse " + p_expression.substr(p_position);
+        return;
       }
     } //END OPERATOR HANDLING
   }
-  debug("parse() finished, computing remaining operators/numbers");
 
-  //Expression is parsed, we now just have to process all remaining operators
-  while( p_state == running && !p_operators.empty() )
-    processOperator();
-
-  if( !p_operators.empty() && !p_numbers.empty() && p_numbers.size() > 1 ) {
-    p_errorstring = "Too few operators!";
-    p_state = syntaxerror;
-    return p_state;
+  //forget processed input once it makes up most of p_expression, so memory stays bounded while feeding
+  if( p_position > 4096 && p_position > p_expression.length()/2 ) {
+    p_expression.erase(0,p_position);
+    p_position = 0;
   }
-
-  if( p_state == running )
-    p_state = complete;
-  p_expression = expression; //p_expression got mutilated during execution, save it for our getError() method
-  return p_state;
 }
 
-//take operator (or function) from stack, try to parse it and push the result onto p_numbers
+//take operator (or function) from stack, try to parse it and push the result onto p_numbers. Operators and functions work element-wise on vectors
 void parser::processOperator() {
   if( p_operators.empty() ) {
     debug("processOperator() p_operators empty");
     p_state = internalerror;
     return;
   }
-  double temp1, temp2;
-  switch( p_operators.top() ) {
-    case operators::plus    : if( p_numbers.size() < 2 ) {
-                                debug("processOperator() plus: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();
-                              temp2 = p_numbers.top();
-                              p_numbers.pop();
-                              p_numbers.push(temp1 + temp2);
-                              debug("processOperator() %v1 + %v2 ",temp2,temp1);
-                              break;
-    case operators::minus   : if( p_numbers.size() < 2 ) {
-                                debug("processOperator() minus: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();
-                              temp2 = p_numbers.top();
-                              p_numbers.pop();
-                              p_numbers.push(temp2 - temp1); //take care of correct sequence!
-                              debug("processOperator() %v1 - %v2 ",temp2,temp1);
-                              break;
-    case operators::times   : if( p_numbers.size() < 2 ) {
-                                debug("processOperator() times: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();
-                              temp2 = p_numbers.top();
-                              p_numbers.pop();
-                              p_numbers.push(temp1 * temp2);
-                              debug("processOperator() %v1 * %v2 ",temp2,temp1);
-                              break;
-    case operators::divide  : if( p_numbers.size() < 2 ) {
-                                debug("processOperator() divide: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();
-                              temp2 = p_numbers.top();
-                              p_numbers.pop();
-                              if( temp1 == 0 ) {
-                                p_state = matherror;
-                                p_errorstring = "Division by zero";
-                                return;
-                              }
-                              p_numbers.push(temp2 / temp1); //take care of correct sequence!
-                              debug("processOperator() %v1 / %v2 ",temp2,temp1);
-                              break;
-    case operators::pow     : if( p_numbers.size() < 2 ) {
-                                debug("processOperator() pow: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();
-                              temp2 = p_numbers.top();
-                              p_numbers.pop();
-                              p_numbers.push(pow(temp2,temp1));
-                              debug("processOperator() %v1 ^ %v2 ",temp2,temp1);
-                              break;
-    case operators::negation : if( p_numbers.size() < 1 ) {
-                                debug("processOperator() negation: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();
-                              p_numbers.push(-1*temp1);
-                              debug("processOperator() -1 * %v1 ",temp1);
-                              break;
-    case operators::sin     : if( p_numbers.size() < 1 ) {
-                                debug("processOperator() sin: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();
-                              temp2 = sin(temp1);
-                              if( fabs(temp2) < numeric_limits<double>::epsilon()*(2*temp1/LPI) ) //workaround for sin(n*pi) != 0
-                                temp2 = 0;
-                              p_numbers.push(temp2);
-                              debug("processOperator() sin(%v1) = %v2",temp1,temp2);
-                              break;
-    case operators::cos     : if( p_numbers.size() < 1 ) {
-                                debug("processOperator() cos: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();
-                              temp2 = cos(temp1);
-                              if( fabs(temp2) < numeric_limits<double>::epsilon()*(2*temp1/LPI) )
-                                temp2 = 0;
-                              p_numbers.push(temp2);
-                              debug("processOperator() cos(%v1)",temp1);
-                              break;
-    case operators::tan     : if( p_numbers.size() < 1 ) {
-                                debug("processOperator() tan: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();
-                              temp2 = tan(temp1);
-                              if( fabs(temp2) < numeric_limits<double>::epsilon()*(2*temp1/LPI) )
-                                temp2 = 0;
-                              if( 1/fabs(temp2) < numeric_limits<double>::epsilon()*(2*temp1/LPI) )
-                                temp2 = numeric_limits<double>::infinity();
-                              p_numbers.push(temp2);
-                              debug("processOperator() tan(%v1)",temp1);
-                              break;
-    case operators::arcsin  : if( p_numbers.size() < 1 ) { //no need to check domain, c++ does that for us, e.g. asin(2) returns "nan"
-                                debug("processOperator() arcsin: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();
-                              p_numbers.push(asin(temp1));
-                              debug("processOperator() arcsin(%v1)",temp1);
-                              break;
-    case operators::arccos  : if( p_numbers.size() < 1 ) {
-                                debug("processOperator() arccos: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();
-                              p_numbers.push(acos(temp1));
-                              debug("processOperator() arccos(%v1)",temp1);
-                              break;
-    case operators::arctan  : if( p_numbers.size() < 1 ) {
-                                debug("processOperator() arctan: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();
-                              p_numbers.push(atan(temp1));
-                              debug("processOperator() arctan(%v1)",temp1);
-                              break;
-    case operators::sqrt    : if( p_numbers.size() < 1 ) {
-                                debug("processOperator() sqrt: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();
-                              p_numbers.push(sqrt(temp1));
-                              debug("processOperator() sqrt(%v1)",temp1);
-                              break;
-    case operators::abs     : if( p_numbers.size() < 1 ) {
-                                debug("processOperator() abs: not enough numbers");
-                                p_errorstring = "not enough numbers";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              temp1 = p_numbers.top();
-                              p_numbers.pop();	
-                              p_numbers.push(fabs(temp1));
-                              debug("processOperator() abs(%v1)",temp1);
-                              break;
-    case operators::ans    : if( p_ans != p_ans ) {
-                                debug("processOperator() ans: no previous result");
-                                p_errorstring = "no previous result (ans) available";
-                                p_state = syntaxerror;
-                                return;
-                              }
-                              p_numbers.push(p_ans);
-                              debug("processOperator() ans [%v1]",p_ans);
-                              break;
-    case operators::pi      : p_numbers.push(LPI);
-                              debug("processOperator() pi");
-                              break;
-    case operators::e       : p_numbers.push(LE);
-                              debug("processOperator() e");
-                              break;
-    case operators::lbracket : debug("processOperator() lbracket"); //nothing to do here, lbracket only gets processed while processing the corresponding rbracket, so its save to be pop'ed
-                               break;
-    case operators::rbracket : p_operators.pop(); //pop that rbracket
-                               while( p_state == running && !p_operators.empty() && p_operators.top() != operators::lbracket ) { //process everything until we reach a lbracket
-                                 debug("processOperator() processing rbracket...");
-                                 processOperator();
-                               }
-                               if( p_operators.empty() ) { //no lbracket
+  operators::ops op = p_operators.top();
+  unsigned int slot = 0;
+  if( p_skip == p_operators.size() ) { //reached the and/or that started skipping
+    debug("processOperator() %o1 ends skipping",op);
+    p_skip = 0;
+  }
+  if( p_skip ) {
+    skipOperator();
+    return;
+  }
+  metrics::operation(op);
+  if( op > operators::bracketCount && op < operators::functionCount && op != operators::operatorCount ) { //operators and functions
+    size_t arity = arguments(op);
+    if( p_numbers.size() < arity ) {
+      debug("processOperator() %o1: not enough numbers",op);
+      p_errorstring = "not enough numbers";
+      p_state = syntaxerror;
+      return;
+    }
+    value temp1 = p_numbers.top();
+    p_numbers.pop();
+    if( arity == 3 ) {
+      value temp2 = p_numbers.top(), result;
+      p_numbers.pop();
+      value condition = p_numbers.top();
+      p_numbers.pop();
+      if( !value::select(condition,temp2,temp1,result) ) {
+        p_state = matherror;
+        p_errorstring = "vector sizes differ";
+        return;
+      }
+      p_numbers.push(result);
+      debug("processOperator() if(%v1,...) = %v2",condition.scalar(),result.scalar());
+    }
+    else if( arity == 2 ) {
+      value temp2 = p_numbers.top(), result;
+      p_numbers.pop();
+      if( op == operators::divide && temp1.containsZero() && p_guarded ) //only fails if the branch runs, the program checks while running
+        p_unfolded = true;
+      else if( op == operators::divide && temp1.containsZero() ) {
+        p_state = matherror;
+        p_errorstring = "Division by zero";
+        return;
+      }
+      if( !value::combine(op,temp2,temp1,result) ) { //take care of correct sequence!
+        p_state = matherror;
+        p_errorstring = "vector sizes differ";
+        return;
+      }
+      p_numbers.push(result);
+      debug("processOperator() %v1 %o1 %v2",temp2.scalar(),temp1.scalar(),op);
+    }
+    else {
+      p_numbers.push(value::apply(op,temp1));
+      debug("processOperator() %o1(%v1) = %v2",temp1.scalar(),p_numbers.top().scalar(),op);
+    }
+  }
+  else switch( op ) {
+    case operators::ans      : if( !p_ans.isVector() && p_ans.scalar() != p_ans.scalar() ) {
+                                 debug("processOperator() ans: no previous result");
+                                 p_errorstring = "no previous result (ans) available";
                                  p_state = syntaxerror;
-                                 p_errorstring = "Missing left parenthese";
                                  return;
                                }
+                               p_numbers.push(p_ans);
+                               debug("processOperator() ans [%v1]",p_ans.scalar());
+                               break;
+    case operators::variable : slot = p_slots.top();
+                               p_slots.pop();
+                               p_numbers.push(p_variables[slot]);
+                               debug("processOperator() variable [%v1]",p_variables[slot].scalar());
+                               break;
+    case operators::pi       : p_numbers.push(LPI);
+                               debug("processOperator() pi");
                                break;
+    case operators::e        : p_numbers.push(LE);
+                               debug("processOperator() e");
+                               break;
+    case operators::lbracket : debug("processOperator() lbracket"); //nothing to do here, lbracket only gets processed after everything up to it was processed for the corresponding rbracket (or at the end for a missing one), so its save to be pop'ed
+                               break;
+    case operators::lvector  : p_state = syntaxerror;
+                               p_errorstring = "Missing ]";
+                               return;
     default                  : debug("processOperator() invalid operator (missing implementation)");
                                p_state = internalerror;
                                return;
   }
-  if( p_state == running )
-    p_operators.pop(); //when processing parentheses, this will pop the lbracket
+  if( p_state == running ) {
+    if( p_program )
+      record(op,slot);
+    p_operators.pop();
+  }
+}
+
+//a skipped operator consumes and produces placeholders, so syntax is still checked but nothing gets evaluated (and nothing can fail)
+void parser::skipOperator() {
+  operators::ops op = p_operators.top();
+  debug("processOperator() skipping %o1",op);
+  if( op == operators::lvector ) {
+    p_state = syntaxerror;
+    p_errorstring = "Missing ]";
+    return;
+  }
+  if( op > operators::bracketCount && op < operators::functionCount && op != operators::operatorCount ) {
+    size_t arity = arguments(op);
+    if( p_numbers.size() < arity ) {
+      p_errorstring = "not enough numbers";
+      p_state = syntaxerror;
+      return;
+    }
+    for(size_t n = 0; n < arity; n++)
+      p_numbers.pop();
+  }
+  if( op == operators::variable )
+    p_slots.pop();
+  if( op != operators::lbracket )
+    p_numbers.push(value());
+  p_operators.pop();
+}
+
+//rank of op when deciding which operator to process first, the enum order except that comparisons share one rank.
+//Equal ranks are processed left to right, so 1<2>0.5 is (1<2)>0.5
+unsigned int parser::precedence(operators::ops op) {
+  if( op >= operators::equal && op <= operators::greaterEqual )
+    return operators::equal;
+  return op;
+}
+
+//number of values op takes from p_numbers
+size_t parser::arguments(operators::ops op) {
+  if( op == operators::conditional )
+    return 3;
+  if( op < operators::negation || op == operators::dot )
+    return 2;
+  return 1;
+}
+
+//process everything back to the lbracket, then the function the parentheses belong to.
+//This loops on p_operators instead of recursing, so nesting depth is only limited by memory
+void parser::closeBracket() {
+  while( p_state == running && !p_operators.empty() && p_operators.top() != operators::lbracket && p_operators.top() != operators::lvector ) {
+    debug("parse() processing rbracket...");
+    processOperator();
+  }
+  if( p_state != running )
+    return;
+  if( p_operators.empty() || p_operators.top() == operators::lvector ) { //no lbracket
+    p_state = syntaxerror;
+    p_errorstring = "Missing left parenthese";
+    return;
+  }
+  if( !p_conditionals.empty() && p_conditionals.top().level == p_operators.size() ) { //end of if(c,a,b)
+    if( p_skip == p_operators.size() )
+      p_skip = 0;
+    if( p_program && p_commas.top() == 2 ) {
+      p_program->target(p_conditionals.top().jumpAt);
+      p_guarded--;
+    }
+    p_conditionals.pop();
+  }
+  processOperator(); //pops the lbracket
+  unsigned int count = p_commas.top()+1;
+  p_commas.pop();
+  if( !p_operators.empty() && p_operators.top() > operators::operatorCount && p_operators.top() < operators::functionCount ) {
+    debug("parse() rbracket belongs to operator %o1, calculating...",p_operators.top());
+    if( count != arguments(p_operators.top()) ) {
+      p_state = syntaxerror;
+      p_errorstring = "wrong number of arguments for "+o2s(p_operators.top());
+      return;
+    }
+    processOperator();
+  }
+  else if( count != 1 ) {
+    p_state = syntaxerror;
+    p_errorstring = "comma outside of function arguments or vector";
+  }
+}
+
+//finish the current argument or vector element, it stays on p_numbers. The condition of if(c,a,b) decides which branch gets skipped
+void parser::nextArgument() {
+  while( p_state == running && !p_operators.empty() && p_operators.top() != operators::lbracket && p_operators.top() != operators::lvector )
+    processOperator();
+  if( p_state != running )
+    return;
+  if( p_operators.empty() ) {
+    p_state = syntaxerror;
+    p_errorstring = "comma outside of function arguments or vector";
+    return;
+  }
+  if( !p_conditionals.empty() && p_conditionals.top().level == p_operators.size() ) {
+    ifBracket &c = p_conditionals.top();
+    if( p_commas.top() == 0 ) { //condition complete
+      if( p_program ) { //compiled programs decide while running
+        c.jumpAt = p_program->jump(operators::jumpUnless);
+        p_guarded++;
+      }
+      else if( !p_skip && !p_numbers.empty() && !p_numbers.top().isVector() ) {
+        c.branch = value::truth(p_numbers.top().scalar()) ? 1 : 2;
+        if( c.branch == 2 )
+          p_skip = c.level;
+      }
+    }
+    else if( p_commas.top() == 1 ) { //first branch complete
+      if( p_program ) {
+        size_t jumpAt = p_program->jump(operators::jump);
+        p_program->target(c.jumpAt);
+        c.jumpAt = jumpAt;
+      }
+      else if( p_skip == c.level )
+        p_skip = 0;
+      else if( c.branch == 1 )
+        p_skip = c.level;
+    }
+  }
+  p_commas.top()++;
+}
+
+//process everything back to the lvector and replace the numbers found since then by one vector
+void parser::closeVector() {
+  while( p_state == running && !p_operators.empty() && p_operators.top() != operators::lbracket && p_operators.top() != operators::lvector )
+    processOperator();
+  if( p_state != running )
+    return;
+  if( p_operators.empty() || p_operators.top() == operators::lbracket ) {
+    p_state = syntaxerror;
+    p_errorstring = "Missing [";
+    return;
+  }
+  p_operators.pop();
+  size_t count = p_numbers.size()-p_vectorStarts.top();
+  unsigned int commas = p_commas.top();
+  p_vectorStarts.pop();
+  p_commas.pop();
+  if( count != commas+1 && !(count == 0 && commas == 0) ) {
+    p_state = syntaxerror;
+    p_errorstring = "empty vector element";
+    return;
+  }
+  if( p_skip ) {
+    for(size_t n = 0; n < count; n++)
+      p_numbers.pop();
+    p_numbers.push(value());
+    return;
+  }
+  if( p_program ) {
+    p_state = syntaxerror;
+    p_errorstring = "vectors can not be compiled";
+    return;
+  }
+  vector<double> elements(count);
+  for(size_t n = count; n > 0; n--) {
+    if( p_numbers.top().isVector() ) {
+      p_state = syntaxerror;
+      p_errorstring = "vectors can not be nested";
+      return;
+    }
+    elements[n-1] = p_numbers.top().scalar();
+    p_numbers.pop();
+  }
+  p_numbers.push(value(elements));
+  debug("parse() vector of %v1 elements",count);
+}
+
+//append the operator just processed to p_program, the value it produced is on top of p_numbers
+void parser::record(operators::ops op, unsigned int slot) {
+  size_t jumpAt;
+  switch( op ) {
+    case operators::lbracket : break;
+    case operators::pi       :
+    case operators::e        : p_program->push(p_numbers.top().scalar());
+                               break;
+    case operators::ans      : if( p_numbers.top().isVector() ) {
+                                 p_state = syntaxerror;
+                                 p_errorstring = "vectors can not be compiled";
+                                 return;
+                               }
+                               p_program->push(p_numbers.top().scalar());
+                               break;
+    case operators::variable : p_program->load(slot);
+                               break;
+    case operators::sum      :
+    case operators::mean     :
+    case operators::min      :
+    case operators::max      : break; //reductions of scalars don't change them
+    case operators::dot      : p_program->apply(operators::times,p_numbers.top().scalar());
+                               break;
+    case operators::conditional : break; //the jumps were recorded by nextArgument() and closeBracket()
+    case operators::logicalAnd  : p_program->apply(op,0,false); //1 and b, finished by the else branch 0
+                                  jumpAt = p_program->jump(operators::jump);
+                                  p_program->target(p_shortCircuits.top());
+                                  p_program->push(0);
+                                  p_program->target(jumpAt);
+                                  p_shortCircuits.pop();
+                                  p_guarded--;
+                                  break;
+    case operators::logicalOr   : p_program->apply(op,0,false); //0 or b
+                                  p_program->target(p_shortCircuits.top());
+                                  p_shortCircuits.pop();
+                                  p_guarded--;
+                                  break;
+    default                  : p_program->apply(op,p_numbers.top().scalar(),!p_unfolded);
+                               p_unfolded = false;
+  }
+}
+
+//parse expression into prog, which may then be evaluated for arbitrary variable values. Variables are unknown (NaN) while compiling, so they can't trigger math errors.
+//Compiling does not count as a calculation, result() and ans stay untouched
+parser::state parser::compile(const string& expression, program& prog) {
+  prog.clear();
+  stack<value> numbers(p_numbers);
+  vector<value> values(p_variables.size(),value(numeric_limits<double>::quiet_NaN()));
+  p_variables.swap(values);
+  p_program = &prog;
+  state result = parse(expression);
+  p_program = 0;
+  p_variables.swap(values);
+  if( result != complete )
+    prog.clear();
+  p_numbers.swap(numbers);
+  return result;
 }
 
 //reset internal data structures
 void parser::clear() {
   p_expression.clear();
+  p_position = 0;
   for(int i=p_numbers.size(); i>0; i--)
     p_numbers.pop();
   for(int i=p_operators.size(); i>0; i--)
     p_operators.pop();
+  for(int i=p_slots.size(); i>0; i--)
+    p_slots.pop();
+  for(int i=p_commas.size(); i>0; i--)
+    p_commas.pop();
+  for(int i=p_vectorStarts.size(); i>0; i--)
+    p_vectorStarts.pop();
+  for(int i=p_conditionals.size(); i>0; i--)
+    p_conditionals.pop();
+  for(int i=p_shortCircuits.size(); i>0; i--)
+    p_shortCircuits.pop();
+  p_skip = 0;
+  p_guarded = 0;
+  p_unfolded = false;
   p_state = complete;
 }
 
-//Tries to extract a number at the beginning of p_expression, returns true on success and sets value to the extracted number. Otherwise returns false, value is not proved to remain unchanged in both cases
-bool parser::extractNumber(double &value) {
-  debug("extractNumber "+p_expression);
-  size_t find = p_expression.find('e');
-  string save(find < p_expression.npos ? p_expression.substr(find,p_expression.npos) : "");
-  istringstream convert;
-  convert.str(p_expression.substr(0,find)); //make sure to not scan small 'e', only 'E' will be used to do "*10^"
-  if( convert >> value ) {
-    string temp;
-    convert >> temp; //on success, write the remaining unconverted part back to p_expression for further analysis
-    p_expression = temp+save;
-    return true;
+//Tries to extract a number at p_position of p_expression, on success sets value to the extracted number and skips it. Otherwise value is not proved to remain unchanged.
+//Returns needInput if the number might continue beyond the end of p_expression and final is not set
+parser::lexed parser::extractNumber(double &value, bool final) {
+  uint64_t start = p_sampled ? metrics::now() : 0;
+  const char *first = p_expression.data()+p_position, *last = p_expression.data()+p_expression.length(), *it = first;
+  if( it < last && (*it == '+' || *it == '-') )
+    it++;
+  const char *mantissa = it;
+  while( it < last && isdigit(*it) )
+    it++;
+  size_t digits = it-mantissa;
+  if( it < last && *it == '.' ) {
+    const char *fraction = ++it;
+    while( it < last && isdigit(*it) )
+      it++;
+    digits += it-fraction;
   }
-  else
-    return false;
+  bool open = it == last; //the number may continue in the next chunk
+  if( digits > 0 && it < last && *it == 'E' ) { //only 'E' will be used to do "*10^", small 'e' is Euler's number
+    const char *exponent = it+1;
+    if( exponent < last && (*exponent == '+' || *exponent == '-') )
+      exponent++;
+    const char *exponentDigits = exponent;
+    while( exponent < last && isdigit(*exponent) )
+      exponent++;
+    if( exponent > exponentDigits )
+      it = exponent;
+    open = exponent == last;
+  }
+  lexed result = notFound;
+  if( open && !final )
+    result = needInput;
+  else if( digits > 0 ) {
+    from_chars_result converted = from_chars(*first == '+' ? first+1 : first,it,value);
+    if( converted.ec == errc() && converted.ptr == it ) {
+      p_position += it-first;
+      metrics::token();
+      result = found;
+    }
+  }
+  if( p_sampled )
+    p_lexTime += metrics::now()-start;
+  return result;
 }
 
-//Behaviour similar to extractNumber
-bool parser::extractOperator(operators::ops &op) {
-  int processed = p_expression.length();
-  while( processed >= 0 && !string2operator(p_expression.substr(0,processed),op) ) //terminates when substring is operator or we reached processed = 0, then we have an syntax error
-    processed--;
-  if( processed >= 0 ) {
-    p_expression = p_expression.substr(processed,p_expression.length()-processed); //strip processed bytes
-    return true;
+//Behaviour similar to extractNumber, the longest operator (or variable) name matching at p_position wins
+parser::lexed parser::extractOperator(operators::ops &op, bool final) {
+  uint64_t start = p_sampled ? metrics::now() : 0;
+  size_t available = p_expression.length()-p_position;
+  lexed result = notFound;
+  if( available <= p_tokenLength && !final ) //a longer name might match once the next chunk arrives
+    result = needInput;
+  else {
+    size_t processed = available < p_tokenLength ? available : p_tokenLength;
+    while( processed > 0 && !string2operator(p_expression.substr(p_position,processed),op) ) //terminates when substring is operator or we reached processed = 0, then we have an syntax error
+      processed--;
+    if( processed > 0 ) {
+      p_position += processed; //skip processed bytes
+      metrics::token();
+      result = found;
+    }
   }
-  else
-    return false;
+  if( p_sampled )
+    p_lexTime += metrics::now()-start;
+  return result;
 }
 
 //returns true if the operator exists and sets op to the corresponding enum, otherwise returns false
@@ -430,6 +715,11 @@ bool parser::string2operator(const string &str, operators::ops &op) {
     op = p_opmap[str];
     return true;
   }
+  else if( p_varmap.count(str) ) {
+    op = operators::variable;
+    p_foundSlot = p_varmap[str];
+    return true;
+  }
   else
     return false;
 }
@@ -437,11 +727,74 @@ bool parser::string2operator(const string &str, operators::ops &op) {
 //result access function
 double parser::result() {
   if( !p_numbers.empty() )
-    return p_numbers.top();
+    return p_numbers.top().scalar();
   else
     return 0;
 }
 
+//result access function for vector results
+const value& parser::resultValue() {
+  static const value zero;
+  if( !p_numbers.empty() )
+    return p_numbers.top();
+  else
+    return zero;
+}
+
+//the value ans refers to in the next expression
+const value& parser::answer() {
+  if( !p_numbers.empty() )
+    return p_numbers.top();
+  return p_ans;
+}
+
+//store an externally computed value (e.g. by a solver) as result, so it is available as ans
+void parser::setResult(const value& result) {
+  clear();
+  p_numbers.push(result);
+}
+
+//make name usable in expressions, returns its slot for setVariable() and program::evaluate()
+unsigned int parser::defineVariable(const string& name) {
+  if( !p_varmap.count(name) ) {
+    p_varmap[name] = p_variables.size();
+    p_variables.push_back(0);
+    if( name.length() > p_tokenLength )
+      p_tokenLength = name.length();
+  }
+  return p_varmap[name];
+}
+
+//why name can not be passed to defineVariable(), empty if it can. Other names would be read as something else:
+//e as Euler's number, max( as the function, a b as ab
+string parser::checkName(const string& name) {
+  if( name.empty() )
+    return "is empty";
+  if( isdigit((unsigned char)name[0]) )
+    return "starts with a digit";
+  for(string::const_iterator it = name.begin(); it != name.end(); it++)
+    if( !isalnum((unsigned char)*it) && *it != '_' )
+      return "may only contain letters, digits and _";
+  if( p_opmap.count(name) )
+    return "is an operator, function or constant";
+  return string();
+}
+
+void parser::setVariable(unsigned int slot, double value) {
+  if( slot < p_variables.size() )
+    p_variables[slot] = value;
+}
+
+void parser::setVariable(unsigned int slot, const vector<double>& elements) {
+  if( slot < p_variables.size() )
+    p_variables[slot] = value(elements);
+}
+
+void parser::clearVariables() {
+  p_varmap.clear();
+  p_variables.clear();
+}
+
 //get a nice error string in case parsing fails
 string parser::getError() {
   switch( p_state ) {
@@ -450,6 +803,8 @@ string parser::getError() {
     case syntaxerror : return "Syntax error: "+p_errorstring;
     case matherror : return "Math error: "+p_errorstring;
     case internalerror : return "Internal parser error. This should not happen. Debug info:\nexpression "+p_expression+(p_errorstring.empty() ? string() : "error "+p_errorstring);
+    case timeout : return "Time limit exceeded";
+    case cancelled : return "Cancelled";
   }
 }
 
@@ -494,6 +849,19 @@ string parser::o2s(const operators::ops op) {
   return string();
 }
 
+//limit is asked while parsing and evaluating, 0 parses without limit. The caller starts it for every call
+void parser::setDeadline(const deadline *limit) {
+  p_deadline = limit;
+}
+
+//counting is cheaper than reading the clock, so the deadline is only asked every 256 steps
+bool parser::expired() {
+  if( !p_deadline || ++p_steps%256 != 0 || !p_deadline->passed() )
+    return false;
+  p_state = p_deadline->cancelled() ? cancelled : timeout;
+  return true;
+}
+
 void parser::setDebug(bool active) {
   p_debug = active;
 }
@@ -12,30 +12,61 @@
 #include <string>
 #include <stack>
 #include <map>
+#include <vector>
+#include <stdint.h>
+
+#include "value.h"
+#include "deadline.h"
 
 using namespace std;
 
+class program;
+
 namespace operators { //Namespace to avoid conflicts
-  //sorted by importance, more important operators will usually be processed preferably (except parentheses)
-  enum ops { none, lbracket, rbracket, bracketCount, plus, minus, times, divide, pow, negation, operatorCount, sin, cos, tan, arcsin, arccos, arctan, sqrt, abs, functionCount, pi, e, ans, constantCount };
+  //sorted by importance, more important operators will usually be processed preferably (except parentheses). Comparisons share one rank, see parser::precedence()
+  //jump and jumpUnless never appear in expressions, they implement conditional in compiled programs
+  enum ops { none, lbracket, rbracket, lvector, rvector, comma, bracketCount, logicalOr, logicalAnd, equal, notEqual, less, lessEqual, greater, greaterEqual, plus, minus, times, divide, pow, negation, operatorCount, sin, cos, tan, arcsin, arccos, arctan, sqrt, abs, sum, mean, min, max, dot, conditional, functionCount, pi, e, ans, variable, constantCount, jump, jumpUnless };
 };
 
 class parser {
 public:
   parser();
-  enum state { running, complete, syntaxerror, matherror, internalerror };
+  enum state { running, complete, syntaxerror, matherror, internalerror, timeout, cancelled };
   state parse(const string& expression);
+  void begin();
+  state feed(const string& chunk);
+  state finish();
+  state compile(const string& expression, program& prog);
   void clear();
   string getError();
   double result();
+  const value& resultValue();
+  const value& answer();
+  void setResult(const value& result);
+  string checkName(const string& name);
+  unsigned int defineVariable(const string& name);
+  void setVariable(unsigned int slot, double value); //for code embedding the parser, calculate's modes bind variables in compiled programs,
+  void setVariable(unsigned int slot, const vector<double>& elements); //which only take scalars. Vectors come from [...] literals and ans
+  void clearVariables();
+  void setDeadline(const deadline *limit);
   void setDebug(bool active);
   bool getDebug();
 
 private:
-  bool extractNumber(double &value);
-  bool extractOperator(operators::ops &op);
+  enum lexed { found, notFound, needInput };
+  void tokenize(bool final);
+  lexed extractNumber(double &value, bool final);
+  lexed extractOperator(operators::ops &op, bool final);
   bool string2operator(const string &str, operators::ops &op);
   void processOperator();
+  void closeBracket();
+  void closeVector();
+  void nextArgument();
+  void skipOperator();
+  static unsigned int precedence(operators::ops op);
+  static size_t arguments(operators::ops op);
+  void record(operators::ops op, unsigned int slot);
+  bool expired();
 
   void debug(const string& message, const double v1 = 0, const double v2 = 0, const operators::ops op1 = operators::none, const operators::ops op2 = operators::none);
   void debug(const string& message, const operators::ops op1, const operators::ops op2 = operators::none);
@@ -43,13 +74,40 @@ private:
   string o2s(const operators::ops op);
 
   state p_state;
-  string p_expression;
-  stack<double> p_numbers;
+  string p_expression; //input not processed yet (starting at p_position)
+  size_t p_position;
+  size_t p_tokenLength; //longest operator or variable name
+  bool p_needOperator; //helps deciding between +/- signs or operators ( and to process "missing" *'s)
+  stack<value> p_numbers;
   stack<operators::ops> p_operators;
   map<string,operators::ops> p_opmap;
-  double p_ans;
+  map<string,unsigned int> p_varmap;
+  vector<value> p_variables;
+  stack<unsigned int> p_commas; //commas found inside each open parenthese or vector
+  stack<size_t> p_vectorStarts; //size of p_numbers when each open vector began
+  struct ifBracket {
+    size_t level;  //size of p_operators while the parenthese of if(c,a,b) is on top
+    int branch;    //1 or 2 once c decided which branch to evaluate, 0 if both are (c is a vector or we are compiling)
+    size_t jumpAt; //pending jump in p_program
+  };
+  stack<ifBracket> p_conditionals;
+  size_t p_skip; //while nonzero, operators are only checked for syntax, not evaluated. Skipping ends when p_operators shrinks to this size again
+  stack<size_t> p_shortCircuits; //compiled and/or whose right side is being recorded: the jump to point behind it
+  unsigned int p_guarded; //compiled if(c,a,b) branches and right sides of and/or being recorded. Their math errors are left to the program, which only runs one branch
+  bool p_unfolded; //the operator just processed failed in a guarded branch, record it instead of its result
+  stack<unsigned int> p_slots; //variable slots of operators::variable entries on p_operators
+  unsigned int p_foundSlot;
+  program *p_program; //if set, parse() records the expression into it
+  value p_ans;
   string p_errorstring;
   bool p_debug;
+  const deadline *p_deadline; //budget of the current call, asked every few hundred tokens and operators
+  unsigned int p_steps;
+  static const unsigned int sampleRate = 16; //one in sampleRate expressions has its latency measured
+  uint64_t p_lexTime; //nanoseconds spent in extractNumber() and extractOperator() for the current expression, if sampled
+  uint64_t p_busyTime; //nanoseconds spent in feed() and finish() for the current expression, if sampled
+  bool p_sampled;
+  unsigned int p_expressions;
 };
 
 #endif //PARSER_H
@@ -0,0 +1,379 @@
+/***********************************************************/
+/*              program class implementation               */
+/***********************************************************/
+
+#include "program.h"
+#include "value.h"
+#include "metrics.h"
+
+#include <cmath>
+#include <limits>
+#include <stdint.h>
+
+static bool isBinary(unsigned int op) {
+  return op > operators::bracketCount && op < operators::negation;
+}
+
+//conditionals whose points disagree in a block run both branches, the results are blended when the second one ends
+struct blend {
+  size_t elseAt; //first instruction of the second branch
+  size_t end;    //instruction after the second branch, known once the first branch ended
+  uint64_t mask; //points taking the first branch
+  uint64_t active; //points active before the conditional
+};
+
+//boxes on which the condition may be both true and false run both branches, the result is their hull
+struct hull {
+  size_t elseAt;
+  size_t end;
+};
+
+program::program() {
+  clear();
+}
+
+void program::clear() {
+  p_code.clear();
+  p_view = 0;
+  p_viewSize = 0;
+  p_depth = 0;
+  p_maxDepth = 0;
+  p_barrier = 0;
+  p_variableCount = 0;
+}
+
+//refer to size instructions at code instead of owning them, code has to stay valid as long as it is used
+void program::assign(const instruction *code, size_t size, unsigned int variableCount, size_t depth) {
+  clear();
+  p_view = code;
+  p_viewSize = size;
+  p_variableCount = variableCount;
+  p_maxDepth = depth;
+}
+
+bool program::empty() const {
+  return size() == 0;
+}
+
+size_t program::size() const {
+  return p_view ? p_viewSize : p_code.size();
+}
+
+size_t program::depth() const {
+  return p_maxDepth;
+}
+
+const program::instruction* program::code() const {
+  return p_view ? p_view : (p_code.empty() ? 0 : &p_code[0]);
+}
+
+unsigned int program::variableCount() const {
+  return p_variableCount;
+}
+
+void program::push(double value) {
+  instruction i;
+  i.value = value;
+  i.op = operators::none;
+  i.slot = 0;
+  p_code.push_back(i);
+  if( ++p_depth > p_maxDepth )
+    p_maxDepth = p_depth;
+}
+
+void program::load(unsigned int slot) {
+  instruction i;
+  i.value = 0;
+  i.op = operators::variable;
+  i.slot = slot;
+  p_code.push_back(i);
+  if( slot >= p_variableCount )
+    p_variableCount = slot+1;
+  if( ++p_depth > p_maxDepth )
+    p_maxDepth = p_depth;
+}
+
+//record op, result is what the parser computed for it. If all operands are constants, the parser already did our job and we just keep the result
+void program::apply(operators::ops op, double result, bool fold) {
+  size_t arity = isBinary(op) ? 2 : 1;
+  bool constant = fold && p_code.size() >= p_barrier+arity;
+  for(size_t n = 1; constant && n <= arity; n++)
+    constant = p_code[p_code.size()-n].op == operators::none;
+  if( constant ) {
+    p_code.resize(p_code.size()-arity);
+    p_depth -= arity;
+    push(result);
+    return;
+  }
+  instruction i;
+  i.value = 0;
+  i.op = op;
+  i.slot = 0;
+  p_code.push_back(i);
+  p_depth -= arity-1;
+}
+
+//record a jump with unknown target, returns its position for target()
+size_t program::jump(operators::ops op) {
+  instruction i;
+  i.value = 0;
+  i.op = op;
+  i.slot = 0;
+  p_code.push_back(i);
+  if( op == operators::jumpUnless ) //pops the condition. The first branch's result stays until the jump's target, blocks blend it with the second one's there
+    p_depth--;
+  return p_code.size()-1;
+}
+
+//let the jump recorded at position jump continue with the next instruction recorded
+void program::target(size_t jump) {
+  p_code[jump].slot = p_code.size();
+  p_barrier = p_code.size();
+  if( p_code[jump].op == operators::jump )
+    p_depth--;
+}
+
+//evaluate for a single set of variables, stack is scratch space that may be reused between calls.
+//Single points are too fast to read the clock for each of them, only every sampleRate-th call per thread is timed
+parser::state program::evaluate(const double *variables, double &result, vector<double> &stack) const {
+  static thread_local unsigned int calls = 0;
+  bool sampled = calls++%sampleRate == 0;
+  uint64_t start = sampled ? metrics::now() : 0;
+  parser::state state = execute(variables,result,stack);
+  if( sampled )
+    metrics::time(metrics::run,metrics::now()-start);
+  metrics::evaluated(state,1);
+  return state;
+}
+
+parser::state program::execute(const double *variables, double &result, vector<double> &stack) const {
+  if( empty() )
+    return parser::internalerror;
+  if( stack.size() < p_maxDepth )
+    stack.resize(p_maxDepth);
+  double *top = &stack[0]-1;
+  const instruction *start = code();
+  for(const instruction *it = start, *end = start+size(); it != end; it++) {
+    switch( it->op ) {
+      case operators::none       : *++top = it->value;
+                                   break;
+      case operators::variable   : *++top = variables[it->slot];
+                                   break;
+      case operators::plus       : top--;
+                                   top[0] += top[1];
+                                   break;
+      case operators::minus      : top--;
+                                   top[0] -= top[1];
+                                   break;
+      case operators::times      : top--;
+                                   top[0] *= top[1];
+                                   break;
+      case operators::divide     : top--;
+                                   if( top[1] == 0 )
+                                     return parser::matherror;
+                                   top[0] /= top[1];
+                                   break;
+      case operators::pow        : top--;
+                                   top[0] = pow(top[0],top[1]);
+                                   break;
+      case operators::jumpUnless : if( !value::truth(*top--) )
+                                     it = start+it->slot-1;
+                                   break;
+      case operators::jump       : it = start+it->slot-1;
+                                   break;
+      default                    : if( isBinary(it->op) ) {
+                                     top--;
+                                     top[0] = value::operation(it->op,top[0],top[1]);
+                                   }
+                                   else
+                                     top[0] = value::function(it->op,top[0]);
+    }
+  }
+  result = *top;
+  return parser::complete;
+}
+
+//bound the expression for all variable values inside the intervals, the result encloses every value a point evaluation could return
+parser::state program::evaluate(const interval *variables, interval &result, vector<interval> &stack) const {
+  uint64_t start = metrics::now();
+  parser::state state = execute(variables,result,stack);
+  metrics::time(metrics::run,metrics::now()-start);
+  metrics::evaluated(state,1);
+  return state;
+}
+
+parser::state program::execute(const interval *variables, interval &result, vector<interval> &stack) const {
+  if( empty() )
+    return parser::internalerror;
+  if( stack.size() < p_maxDepth )
+    stack.resize(p_maxDepth);
+  interval *top = &stack[0]-1;
+  vector<hull> hulls;
+  for(size_t pc = 0; ; pc++) {
+    while( !hulls.empty() && hulls.back().end == pc ) {
+      top--;
+      top[0] = interval::hull(top[0],top[1]);
+      hulls.pop_back();
+    }
+    if( pc == size() )
+      break;
+    const instruction *it = code()+pc;
+    switch( it->op ) {
+      case operators::none       : *++top = interval(it->value);
+                                   break;
+      case operators::variable   : *++top = variables[it->slot];
+                                   break;
+      case operators::plus       : top--;
+                                   top[0] = interval::add(top[0],top[1]);
+                                   break;
+      case operators::minus      : top--;
+                                   top[0] = interval::subtract(top[0],top[1]);
+                                   break;
+      case operators::times      : top--;
+                                   top[0] = interval::multiply(top[0],top[1]);
+                                   break;
+      case operators::divide     : top--;
+                                   if( top[1].lower == 0 && top[1].upper == 0 )
+                                     return parser::matherror;
+                                   top[0] = interval::divide(top[0],top[1]);
+                                   break;
+      case operators::pow        : top--;
+                                   top[0] = interval::power(top[0],top[1]);
+                                   break;
+      case operators::jumpUnless : top--;
+                                   if( top[1].lower == 0 && top[1].upper == 0 ) //certainly false
+                                     pc = it->slot-1;
+                                   else if( top[1].empty() || top[1].contains(0) ) { //may be either
+                                     hull h = { it->slot, 0 };
+                                     hulls.push_back(h);
+                                   }
+                                   break;
+      case operators::jump       : if( !hulls.empty() && hulls.back().elseAt == pc+1 )
+                                     hulls.back().end = it->slot; //run the second branch too
+                                   else
+                                     pc = it->slot-1;
+                                   break;
+      default                    : if( isBinary(it->op) ) {
+                                     top--;
+                                     top[0] = interval::compare(it->op,top[0],top[1]);
+                                   }
+                                   else
+                                     top[0] = interval::function(it->op,top[0]);
+    }
+  }
+  result = *top;
+  return parser::complete;
+}
+
+//evaluate count points at once, columns[slot] points to count values of each variable. Every instruction runs over a whole block, so the simple
+//loops below are vectorized (compile.sh passes -fopenmp-simd to honor the pragmas). Loops calling pow() or value:: are not
+parser::state program::evaluate(const double *const *columns, size_t count, double *results, vector<double> &stack) const {
+  uint64_t start = metrics::now();
+  parser::state state = execute(columns,count,results,stack);
+  metrics::time(metrics::run,metrics::now()-start);
+  metrics::evaluated(state,count);
+  return state;
+}
+
+parser::state program::execute(const double *const *columns, size_t count, double *results, vector<double> &stack) const {
+  if( empty() )
+    return parser::internalerror;
+  if( stack.size() < p_maxDepth*blockSize )
+    stack.resize(p_maxDepth*blockSize);
+  parser::state state = parser::complete;
+  vector<blend> blends;
+  for(size_t offset = 0; offset < count; offset += blockSize) {
+    size_t n = count-offset < blockSize ? count-offset : blockSize;
+    uint64_t active = n == 64 ? ~uint64_t(0) : (uint64_t(1) << n)-1, mask;
+    double smallest; //divisor closest to 0, only a block containing 0 is checked point by point
+    double *top = &stack[0]-blockSize;
+    for(size_t pc = 0; ; pc++) {
+      while( !blends.empty() && blends.back().end == pc ) {
+        top -= blockSize;
+        mask = blends.back().mask;
+        #pragma omp simd
+        for(size_t i = 0; i < n; i++)
+          top[i] = mask >> i & 1 ? top[i] : top[blockSize+i];
+        active = blends.back().active;
+        blends.pop_back();
+      }
+      if( pc == size() )
+        break;
+      const instruction *it = code()+pc;
+      switch( it->op ) {
+        case operators::none       : top += blockSize;
+                                     #pragma omp simd
+                                     for(size_t i = 0; i < n; i++)
+                                       top[i] = it->value;
+                                     break;
+        case operators::variable   : top += blockSize;
+                                     #pragma omp simd
+                                     for(size_t i = 0; i < n; i++)
+                                       top[i] = columns[it->slot][offset+i];
+                                     break;
+        case operators::plus       : top -= blockSize;
+                                     #pragma omp simd
+                                     for(size_t i = 0; i < n; i++)
+                                       top[i] += top[blockSize+i];
+                                     break;
+        case operators::minus      : top -= blockSize;
+                                     #pragma omp simd
+                                     for(size_t i = 0; i < n; i++)
+                                       top[i] -= top[blockSize+i];
+                                     break;
+        case operators::times      : top -= blockSize;
+                                     #pragma omp simd
+                                     for(size_t i = 0; i < n; i++)
+                                       top[i] *= top[blockSize+i];
+                                     break;
+        case operators::divide     : top -= blockSize;
+                                     smallest = HUGE_VAL;
+                                     #pragma omp simd reduction(min:smallest)
+                                     for(size_t i = 0; i < n; i++) {
+                                       smallest = fabs(top[blockSize+i]) < smallest ? fabs(top[blockSize+i]) : smallest;
+                                       top[i] /= top[blockSize+i];
+                                     }
+                                     for(size_t i = 0; smallest == 0 && i < n; i++) //points of a branch they don't take can't fail
+                                       if( top[blockSize+i] == 0 && active >> i & 1 )
+                                         state = parser::matherror;
+                                     break;
+        case operators::pow        : top -= blockSize;
+                                     for(size_t i = 0; i < n; i++)
+                                       top[i] = pow(top[i],top[blockSize+i]);
+                                     break;
+        case operators::jumpUnless : mask = 0;
+                                     #pragma omp simd reduction(|:mask)
+                                     for(size_t i = 0; i < n; i++)
+                                       mask |= uint64_t(value::truth(top[i])) << i;
+                                     top -= blockSize;
+                                     if( (mask & active) == 0 ) //no point takes the first branch
+                                       pc = it->slot-1;
+                                     else if( (mask & active) != active ) { //points disagree
+                                       blend b = { it->slot, 0, mask, active };
+                                       blends.push_back(b);
+                                       active &= mask;
+                                     }
+                                     break;
+        case operators::jump       : if( !blends.empty() && blends.back().elseAt == pc+1 ) {
+                                       blends.back().end = it->slot;
+                                       active = blends.back().active & ~blends.back().mask;
+                                     }
+                                     else
+                                       pc = it->slot-1;
+                                     break;
+        default                    : if( isBinary(it->op) ) {
+                                       top -= blockSize;
+                                       for(size_t i = 0; i < n; i++)
+                                         top[i] = value::operation(it->op,top[i],top[blockSize+i]);
+                                     }
+                                     else
+                                       for(size_t i = 0; i < n; i++)
+                                         top[i] = value::function(it->op,top[i]);
+      }
+    }
+    #pragma omp simd
+    for(size_t i = 0; i < n; i++)
+      results[offset+i] = top[i];
+  }
+  return state;
+}
@@ -0,0 +1,73 @@
+/***********************************************************/
+/*                    program class                        */
+/* Compiled (postfix) form of an expression as recorded by */
+/* parser::compile(). Can be evaluated many times with     */
+/* different variable values without parsing again, either */
+/* for a single point, for whole blocks of points or for   */
+/* boxes of intervals to bound it.                         */
+/* A program either owns its instructions or refers to     */
+/* instructions stored elsewhere (see library class).      */
+/* if(c,a,b) is recorded as                                */
+/*   c jumpUnless(L1) a jump(L2) L1: b L2:                 */
+/* so only one branch runs. Blocks whose points disagree   */
+/* on c run both branches and blend the results.           */
+/* a and b is recorded as if(a,1 and b,0), a or b as       */
+/* if(a,1,0 or b), so b only runs where it decides.        */
+/***********************************************************/
+
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <vector>
+#include <cstddef>
+
+#include "parser.h"
+#include "interval.h"
+
+using namespace std;
+
+class program {
+public:
+  struct instruction {
+    double value;      //value to push if op is operators::none
+    unsigned int op;   //operators::ops, none pushes value, variable loads slot
+    unsigned int slot; //variable slot for operators::variable, target instruction for jump and jumpUnless
+  };
+  static const size_t blockSize = 64; //points evaluated at once by the block version of evaluate()
+
+  program();
+  void clear();
+  void assign(const instruction *code, size_t size, unsigned int variableCount, size_t depth);
+  bool empty() const;
+  size_t size() const;
+  size_t depth() const;
+  unsigned int variableCount() const;
+  const instruction* code() const;
+
+  //used by parser::compile() to record the expression
+  void push(double value);
+  void load(unsigned int slot);
+  void apply(operators::ops op, double result, bool fold = true);
+  size_t jump(operators::ops op);
+  void target(size_t jump);
+
+  parser::state evaluate(const double *variables, double &result, vector<double> &stack) const;
+  parser::state evaluate(const double *const *columns, size_t count, double *results, vector<double> &stack) const;
+  parser::state evaluate(const interval *variables, interval &result, vector<interval> &stack) const;
+
+private:
+  static const unsigned int sampleRate = 64; //single point evaluations per timed one
+  parser::state execute(const double *variables, double &result, vector<double> &stack) const;
+  parser::state execute(const double *const *columns, size_t count, double *results, vector<double> &stack) const;
+  parser::state execute(const interval *variables, interval &result, vector<interval> &stack) const;
+
+  vector<instruction> p_code;
+  const instruction *p_view; //if set, instructions are not owned and p_code is unused
+  size_t p_viewSize;
+  size_t p_depth;
+  size_t p_maxDepth;
+  size_t p_barrier; //instructions before it may be jumped to, so they must not be folded
+  unsigned int p_variableCount;
+};
+
+#endif //PROGRAM_H
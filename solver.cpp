@@ -0,0 +1,261 @@
+/***********************************************************/
+/*               solver class implementation               */
+/***********************************************************/
+
+#include "solver.h"
+#include "program.h"
+
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <algorithm>
+
+//Gauss-Kronrod 7/15 nodes (positive half, descending) and weights
+static const double xgk[8] = { 0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+                               0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+                               0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+                               0.207784955007898467600689403773245, 0.000000000000000000000000000000000 };
+static const double wgk[8] = { 0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+                               0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+                               0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+                               0.204432940075298892414161999234649, 0.209482141084727828012999174891714 };
+static const double wg[4]  = { 0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+                               0.381830050505118944950369775488975, 0.417959183673469387755102040816327 };
+
+static const int maxIterations = 200;      //root finding
+static const int maxSegments = 5000;       //integration, per panel
+static const unsigned int maxPanels = 8;   //integration, evaluated in parallel
+static const double relativeTolerance = 1e-12;
+static const double absoluteTolerance = 1e-14;
+static const double magnitudeTolerance = 1e-14; //integration, relative to the integral of |f|
+
+solver::solver() : p_deadline(0) {
+}
+
+//find a root of prog in [a,b] using Brent's method, prog has to change its sign in [a,b]
+parser::state solver::solve(const program& prog, unsigned int slot, double a, double b, double &root) {
+  vector<double> variables(prog.variableCount() > slot ? prog.variableCount() : slot+1);
+  vector<double> stack;
+  double fa, fb;
+  variables[slot] = a;
+  parser::state state = prog.evaluate(&variables[0],fa,stack);
+  if( state == parser::complete ) {
+    variables[slot] = b;
+    state = prog.evaluate(&variables[0],fb,stack);
+  }
+  if( state != parser::complete ) {
+    p_errorstring = "unable to evaluate expression at interval bounds";
+    return state;
+  }
+  if( fa == 0 ) {
+    root = a;
+    return parser::complete;
+  }
+  if( fb == 0 ) {
+    root = b;
+    return parser::complete;
+  }
+  if( fa != fa || fb != fb || (fa > 0) == (fb > 0) ) {
+    p_errorstring = "expression does not change its sign in the given interval";
+    return parser::matherror;
+  }
+
+  double c = a, fc = fa, d = b-a, e = d;
+  for(int iteration = 0; iteration < maxIterations; iteration++) {
+    if( (state = expired(p_deadline)) != parser::running ) {
+      p_errorstring = state == parser::timeout ? "Time limit exceeded" : "Cancelled";
+      return state;
+    }
+    if( (fb > 0) == (fc > 0) ) { //keep the root between b and c
+      c = a;
+      fc = fa;
+      d = e = b-a;
+    }
+    if( fabs(fc) < fabs(fb) ) {
+      a = b;
+      b = c;
+      c = a;
+      fa = fb;
+      fb = fc;
+      fc = fa;
+    }
+    double tolerance = 2*numeric_limits<double>::epsilon()*fabs(b)+absoluteTolerance/2;
+    double m = (c-b)/2;
+    if( fabs(m) <= tolerance || fb == 0 ) {
+      root = b;
+      return parser::complete;
+    }
+    if( fabs(e) >= tolerance && fabs(fa) > fabs(fb) ) { //try interpolation
+      double s = fb/fa, p, q;
+      if( a == c ) { //secant
+        p = 2*m*s;
+        q = 1-s;
+      }
+      else { //inverse quadratic
+        double r = fb/fc;
+        q = fa/fc;
+        p = s*(2*m*q*(q-r)-(b-a)*(r-1));
+        q = (q-1)*(r-1)*(s-1);
+      }
+      if( p > 0 )
+        q = -q;
+      else
+        p = -p;
+      if( 2*p < 3*m*q-fabs(tolerance*q) && p < fabs(e*q/2) ) {
+        e = d;
+        d = p/q;
+      }
+      else //interpolation failed, bisect
+        d = e = m;
+    }
+    else
+      d = e = m;
+    a = b;
+    fa = fb;
+    b += fabs(d) > tolerance ? d : (m > 0 ? tolerance : -tolerance);
+    variables[slot] = b;
+    state = prog.evaluate(&variables[0],fb,stack);
+    if( state != parser::complete ) {
+      p_errorstring = "unable to evaluate expression while searching root";
+      return state;
+    }
+  }
+  p_errorstring = "root finding did not converge";
+  return parser::matherror;
+}
+
+//integrate prog over [a,b] using adaptive Gauss-Kronrod quadrature. [a,b] is split into panels that are refined in parallel
+//until the error of all of them together is small enough
+parser::state solver::integrate(const program& prog, unsigned int slot, double a, double b, double &result) {
+  if( a == b ) {
+    result = 0;
+    return parser::complete;
+  }
+  unsigned int count = thread::hardware_concurrency();
+  if( count == 0 )
+    count = 1;
+  if( count > maxPanels )
+    count = maxPanels;
+
+  vector<panel> panels(count);
+  for(unsigned int n = 0; n < count; n++) {
+    panels[n].a = a+(b-a)*n/count;
+    panels[n].b = n+1 == count ? b : a+(b-a)*(n+1)/count;
+    panels[n].target = numeric_limits<double>::infinity(); //the first round only estimates
+    panels[n].limit = p_deadline;
+  }
+  while( true ) {
+    vector<thread> threads;
+    for(unsigned int n = 1; n < count; n++)
+      threads.push_back(thread(integratePanel,ref(prog),slot,&panels[n]));
+    integratePanel(prog,slot,&panels[0]);
+    for(vector<thread>::iterator it = threads.begin(); it != threads.end(); it++)
+      it->join();
+
+    double error = 0, magnitude = 0;
+    result = 0;
+    for(vector<panel>::iterator it = panels.begin(); it != panels.end(); it++) {
+      if( it->state != parser::complete ) {
+        if( it->state == parser::timeout || it->state == parser::cancelled )
+          p_errorstring = it->state == parser::timeout ? "Time limit exceeded" : "Cancelled";
+        else
+          p_errorstring = it->state == parser::matherror ? "integration did not converge" : "unable to evaluate expression";
+        return it->state;
+      }
+      result += it->integral;
+      error += it->error;
+      magnitude += it->magnitude;
+    }
+    //the absolute tolerance scales with the integral of |f|, so integrals that cancel out to about 0 converge as well
+    double tolerance = max(magnitudeTolerance*magnitude,relativeTolerance*fabs(result));
+    if( error <= tolerance )
+      return parser::complete;
+    for(vector<panel>::iterator it = panels.begin(); it != panels.end(); it++)
+      it->target = tolerance/count;
+  }
+}
+
+//limit is asked while solving, 0 solves without limit. The caller starts it for every call
+void solver::setDeadline(const deadline *limit) {
+  p_deadline = limit;
+}
+
+//running if there is time left, otherwise the state to give up with
+parser::state solver::expired(const deadline *limit) {
+  if( !limit || !limit->passed() )
+    return parser::running;
+  return limit->cancelled() ? parser::cancelled : parser::timeout;
+}
+
+string solver::getError() {
+  return p_errorstring;
+}
+
+//apply the 15 point Kronrod rule to s, the difference to the embedded 7 point Gauss rule estimates the error
+parser::state solver::kronrod(const program& prog, unsigned int slot, segment &s, vector<double> &nodes, vector<double> &values, vector<double> &stack) {
+  double center = (s.a+s.b)/2, half = (s.b-s.a)/2;
+  for(int j = 0; j < 7; j++) {
+    nodes[j] = center-half*xgk[j];
+    nodes[14-j] = center+half*xgk[j];
+  }
+  nodes[7] = center;
+  vector<const double*> columns(prog.variableCount() > slot ? prog.variableCount() : slot+1,&nodes[0]);
+  parser::state state = prog.evaluate(&columns[0],15,&values[0],stack);
+  if( state != parser::complete )
+    return state;
+  double k = wgk[7]*values[7], g = wg[3]*values[7];
+  for(int j = 0; j < 7; j++) {
+    k += wgk[j]*(values[j]+values[14-j]);
+    if( j%2 == 1 )
+      g += wg[j/2]*(values[j]+values[14-j]);
+  }
+  double absolute = wgk[7]*fabs(values[7]);
+  for(int j = 0; j < 7; j++)
+    absolute += wgk[j]*(fabs(values[j])+fabs(values[14-j]));
+  s.integral = k*half;
+  s.error = fabs((k-g)*half);
+  s.magnitude = absolute*fabs(half);
+  if( s.integral != s.integral )
+    return parser::matherror;
+  return parser::complete;
+}
+
+//refine panel until its error is below its target, always splitting the worst segment. May be called again with a smaller target
+void solver::integratePanel(const program& prog, unsigned int slot, panel *p) {
+  vector<double> nodes(15), values(15), stack;
+  vector<segment> &segments = p->segments;
+  p->state = parser::complete;
+  if( segments.empty() ) {
+    segments.resize(1);
+    segments[0].a = p->a;
+    segments[0].b = p->b;
+    p->state = kronrod(prog,slot,segments[0],nodes,values,stack);
+    if( p->state != parser::complete )
+      return;
+    p->integral = segments[0].integral;
+    p->error = segments[0].error;
+    p->magnitude = segments[0].magnitude;
+  }
+  while( p->error > p->target ) {
+    if( segments.size() >= maxSegments ) {
+      p->state = parser::matherror;
+      return;
+    }
+    if( (p->state = expired(p->limit)) != parser::running )
+      return;
+    size_t worst = 0;
+    for(size_t n = 1; n < segments.size(); n++)
+      if( segments[n].error > segments[worst].error )
+        worst = n;
+    segment left = segments[worst], right = segments[worst];
+    left.b = right.a = (left.a+left.b)/2;
+    if( (p->state = kronrod(prog,slot,left,nodes,values,stack)) != parser::complete || (p->state = kronrod(prog,slot,right,nodes,values,stack)) != parser::complete )
+      return;
+    p->integral += left.integral+right.integral-segments[worst].integral;
+    p->error += left.error+right.error-segments[worst].error;
+    p->magnitude += left.magnitude+right.magnitude-segments[worst].magnitude;
+    segments[worst] = left;
+    segments.push_back(right);
+  }
+  p->state = parser::complete;
+}
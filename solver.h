@@ -0,0 +1,52 @@
+/***********************************************************/
+/*                    solver class                         */
+/* Numeric root finding and integration of a compiled      */
+/* expression in one variable. The expression is parsed    */
+/* once by parser::compile(), the solvers only evaluate    */
+/* the resulting program.                                  */
+/***********************************************************/
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <string>
+#include <vector>
+
+#include "parser.h"
+
+using namespace std;
+
+class program;
+
+class solver {
+public:
+  solver();
+  parser::state solve(const program& prog, unsigned int slot, double a, double b, double &root);
+  parser::state integrate(const program& prog, unsigned int slot, double a, double b, double &result);
+  void setDeadline(const deadline *limit);
+  string getError();
+
+private:
+  struct segment {
+    double a, b;
+    double integral, error;
+    double magnitude; //integral of |f|
+  };
+  struct panel {
+    double a, b;
+    double integral, error, magnitude; //sums over segments
+    double target; //error to refine to
+    vector<segment> segments;
+    parser::state state;
+    const deadline *limit;
+  };
+  static parser::state kronrod(const program& prog, unsigned int slot, segment &s, vector<double> &nodes, vector<double> &values, vector<double> &stack);
+  static void integratePanel(const program& prog, unsigned int slot, panel *p);
+
+  static parser::state expired(const deadline *limit);
+
+  const deadline *p_deadline; //asked once per iteration of solve() and once per segment of integrate()
+  string p_errorstring;
+};
+
+#endif //SOLVER_H
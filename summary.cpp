@@ -0,0 +1,116 @@
+/***********************************************************/
+/*              summary class implementation               */
+/***********************************************************/
+
+#include "summary.h"
+#include "format.h"
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+summary::summary() : p_count(0), p_nan(0), p_sum(0), p_compensation(0), p_lower(0), p_upper(0), p_below(0), p_above(0) {
+  for(int n = 0; n < metrics::stateCount; n++)
+    p_errors[n] = 0;
+  p_min = numeric_limits<double>::infinity();
+  p_max = -numeric_limits<double>::infinity();
+}
+
+//count results in equally wide bins covering [lower,upper), results outside are counted as below or above
+void summary::setHistogram(double lower, double upper, unsigned int bins) {
+  p_lower = lower;
+  p_upper = upper;
+  p_bins.assign(bins,0);
+}
+
+void summary::add(double value) {
+  if( value != value ) {
+    p_nan++;
+    return;
+  }
+  p_count++;
+  accumulate(value);
+  if( value < p_min )
+    p_min = value;
+  if( value > p_max )
+    p_max = value;
+  if( p_bins.empty() )
+    return;
+  if( value < p_lower )
+    p_below++;
+  else if( value >= p_upper )
+    p_above++;
+  else {
+    size_t bin = (value-p_lower)/(p_upper-p_lower)*p_bins.size();
+    p_bins[bin < p_bins.size() ? bin : p_bins.size()-1]++;
+  }
+}
+
+void summary::fail(parser::state state) {
+  if( state < metrics::stateCount )
+    p_errors[state]++;
+}
+
+//Neumaier's variant of Kahan summation, also exact if value is larger than the sum so far.
+//Once the sum is infinite (or NaN from adding both infinities) it stays so, and the compensation would only turn it into NaN
+void summary::accumulate(double value) {
+  double t = p_sum+value;
+  if( !isfinite(t) ) {
+    p_sum = t;
+    return;
+  }
+  if( fabs(p_sum) >= fabs(value) )
+    p_compensation += (p_sum-t)+value;
+  else
+    p_compensation += (value-t)+p_sum;
+  p_sum = t;
+}
+
+//add the results counted by other, which has to use the same histogram bins
+void summary::merge(const summary& other) {
+  p_count += other.p_count;
+  p_nan += other.p_nan;
+  for(int n = 0; n < metrics::stateCount; n++)
+    p_errors[n] += other.p_errors[n];
+  accumulate(other.p_sum);
+  accumulate(other.p_compensation);
+  if( other.p_min < p_min )
+    p_min = other.p_min;
+  if( other.p_max > p_max )
+    p_max = other.p_max;
+  for(size_t n = 0; n < p_bins.size() && n < other.p_bins.size(); n++)
+    p_bins[n] += other.p_bins[n];
+  p_below += other.p_below;
+  p_above += other.p_above;
+}
+
+//one "name value" pair per line, histogram bins as "bin lower upper count"
+string summary::report() const {
+  ostringstream out;
+  char buffer[32];
+  double sum = isfinite(p_sum) ? p_sum+p_compensation : p_sum;
+  uint64_t errors = 0;
+  for(int n = parser::syntaxerror; n < metrics::stateCount; n++)
+    errors += p_errors[n];
+  out << "count " << p_count << '\n';
+  out << "sum " << string(buffer,formatNumber(sum,buffer)) << '\n';
+  if( p_count ) {
+    out << "mean " << string(buffer,formatNumber(sum/p_count,buffer)) << '\n';
+    out << "min " << string(buffer,formatNumber(p_min,buffer)) << '\n';
+    out << "max " << string(buffer,formatNumber(p_max,buffer)) << '\n';
+  }
+  out << "nan " << p_nan << '\n';
+  out << "errors " << errors << '\n';
+  for(int n = parser::syntaxerror; n < metrics::stateCount; n++)
+    if( p_errors[n] )
+      out << metrics::name((parser::state)n) << ' ' << p_errors[n] << '\n';
+  if( !p_bins.empty() ) {
+    out << "below " << p_below << '\n';
+    for(size_t n = 0; n < p_bins.size(); n++) {
+      out << "bin " << string(buffer,formatNumber(p_lower+(p_upper-p_lower)*n/p_bins.size(),buffer));
+      out << ' ' << string(buffer,formatNumber(p_lower+(p_upper-p_lower)*(n+1)/p_bins.size(),buffer)) << ' ' << p_bins[n] << '\n';
+    }
+    out << "above " << p_above << '\n';
+  }
+  return out.str();
+}
@@ -0,0 +1,49 @@
+/***********************************************************/
+/*                    summary class                        */
+/* Statistics of many results gathered in a single pass:   */
+/* count, sum, mean, minimum, maximum, errors and an       */
+/* optional histogram. Threads fill summaries of their     */
+/* own, merge() combines them. Sums are compensated        */
+/* (Neumaier), so adding millions of results keeps the     */
+/* precision of a single addition.                         */
+/***********************************************************/
+
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "parser.h"
+#include "metrics.h"
+
+using namespace std;
+
+class summary {
+public:
+  summary();
+  void setHistogram(double lower, double upper, unsigned int bins);
+  void add(double value);
+  void fail(parser::state state);
+  void merge(const summary& other);
+  string report() const;
+
+private:
+  void accumulate(double value);
+
+  uint64_t p_count;    //results added, NaN results are only counted in p_nan
+  uint64_t p_nan;
+  uint64_t p_errors[metrics::stateCount];
+  double p_sum;
+  double p_compensation; //rounding errors of p_sum, the sum is p_sum+p_compensation unless p_sum is not finite
+  double p_min;
+  double p_max;
+  double p_lower;      //histogram covers [p_lower,p_upper) in p_bins.size() bins
+  double p_upper;
+  vector<uint64_t> p_bins;
+  uint64_t p_below;
+  uint64_t p_above;
+};
+
+#endif //SUMMARY_H
@@ -0,0 +1,167 @@
+/***********************************************************/
+/*               table class implementation                */
+/***********************************************************/
+
+#include "table.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+table::table() : p_data(0), p_length(0) {
+  close();
+}
+
+table::~table() {
+  close();
+}
+
+//load a CSV file, its first line names the columns. Values are parsed straight from the mapped file
+bool table::loadCSV(const string& path) {
+  if( !map(path) )
+    return false;
+  if( !parseCSV() ) {
+    string error = p_errorstring;
+    close();
+    p_errorstring = path+": "+error;
+    return false;
+  }
+  munmap(p_data,p_length); //everything was copied to p_parsed
+  p_data = 0;
+  p_length = 0;
+  return true;
+}
+
+//map a raw columnar file with one column per name, its size has to be a multiple of one row
+bool table::loadBinary(const string& path, const vector<string>& names) {
+  if( names.empty() ) {
+    p_errorstring = "binary tables need column names";
+    return false;
+  }
+  if( !map(path) )
+    return false;
+  if( p_length%(names.size()*sizeof(double)) != 0 ) {
+    close();
+    p_errorstring = path+" does not hold whole rows of "+to_string(names.size())+" doubles";
+    return false;
+  }
+  p_rows = p_length/(names.size()*sizeof(double));
+  p_names = names;
+  for(size_t n = 0; n < names.size(); n++)
+    p_columns.push_back((const double*)p_data+n*p_rows);
+  return true;
+}
+
+bool table::map(const string& path) {
+  close();
+  int fd = open(path.c_str(),O_RDONLY);
+  if( fd < 0 ) {
+    p_errorstring = "unable to open "+path;
+    return false;
+  }
+  struct stat st;
+  if( fstat(fd,&st) != 0 || st.st_size == 0 ) {
+    ::close(fd);
+    p_errorstring = path+" is empty";
+    return false;
+  }
+  p_length = st.st_size;
+  p_data = mmap(0,p_length,PROT_READ,MAP_PRIVATE,fd,0);
+  ::close(fd);
+  if( p_data == MAP_FAILED ) {
+    p_data = 0;
+    p_length = 0;
+    p_errorstring = "unable to map "+path;
+    return false;
+  }
+  madvise(p_data,p_length,MADV_SEQUENTIAL);
+  return true;
+}
+
+void table::close() {
+  if( p_data )
+    munmap(p_data,p_length);
+  p_data = 0;
+  p_length = 0;
+  p_rows = 0;
+  p_names.clear();
+  p_columns.clear();
+  p_parsed.clear();
+}
+
+size_t table::rows() const {
+  return p_rows;
+}
+
+const vector<string>& table::names() const {
+  return p_names;
+}
+
+const double* table::column(size_t n) const {
+  return p_columns[n];
+}
+
+string table::getError() {
+  return p_errorstring;
+}
+
+//blanks around a column name, spaces inside it are kept so the caller can reject the name
+static string trim(const string& name) {
+  size_t first = name.find_first_not_of(" \t\r"), last = name.find_last_not_of(" \t\r");
+  return first == name.npos ? string() : name.substr(first,last-first+1);
+}
+
+bool table::parseCSV() {
+  const char *p = (const char*)p_data, *end = p+p_length;
+  //header
+  string name;
+  for(; p != end && *p != '\n'; p++) {
+    if( *p == ',' ) {
+      p_names.push_back(trim(name));
+      name.clear();
+    }
+    else
+      name += *p;
+  }
+  p_names.push_back(trim(name));
+  p_parsed.resize(p_names.size());
+  //rows
+  size_t line = 1;
+  while( p != end ) {
+    p++; //newline
+    line++;
+    while( p != end && (*p == ' ' || *p == '\t' || *p == '\r') )
+      p++;
+    if( p == end || *p == '\n' ) //empty line
+      continue;
+    for(size_t n = 0; n < p_parsed.size(); n++) {
+      while( p != end && (*p == ' ' || *p == '\t') )
+        p++;
+      double value;
+      from_chars_result r = from_chars(p,end,value);
+      if( r.ec == errc::result_out_of_range ) //from_chars leaves value alone, strtod gives infinity or the denormal
+        value = strtod(string(p,r.ptr).c_str(),0);
+      else if( r.ec != errc() ) {
+        p_errorstring = "line "+to_string(line)+": expected a number in column "+p_names[n];
+        return false;
+      }
+      p = r.ptr;
+      while( p != end && (*p == ' ' || *p == '\t' || *p == '\r') )
+        p++;
+      if( n+1 < p_parsed.size() ? (p == end || *p != ',') : (p != end && *p != '\n') ) {
+        p_errorstring = "line "+to_string(line)+": expected "+to_string(p_parsed.size())+" columns";
+        return false;
+      }
+      if( n+1 < p_parsed.size() )
+        p++;
+      p_parsed[n].push_back(value);
+    }
+  }
+  p_rows = p_parsed[0].size();
+  for(size_t n = 0; n < p_parsed.size(); n++)
+    p_columns.push_back(p_rows ? &p_parsed[n][0] : 0);
+  return true;
+}
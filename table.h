@@ -0,0 +1,44 @@
+/***********************************************************/
+/*                     table class                         */
+/* Named columns of doubles read from a file that is       */
+/* mapped into memory. Either CSV with a header line of    */
+/* column names, or raw columnar binary: all values of the */
+/* first column, then all of the second and so on, native  */
+/* doubles, named by the caller. Binary columns are used   */
+/* in place, nothing is copied.                            */
+/***********************************************************/
+
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class table {
+public:
+  table();
+  ~table();
+  bool loadCSV(const string& path);
+  bool loadBinary(const string& path, const vector<string>& names);
+  void close();
+  size_t rows() const;
+  const vector<string>& names() const;
+  const double* column(size_t n) const;
+  string getError();
+
+private:
+  bool map(const string& path);
+  bool parseCSV();
+
+  void *p_data;
+  size_t p_length;
+  size_t p_rows;
+  vector<string> p_names;
+  vector<const double*> p_columns;
+  vector<vector<double> > p_parsed; //columns of CSV files
+  string p_errorstring;
+};
+
+#endif //TABLE_H
@@ -0,0 +1,182 @@
+#!/bin/bash
+# Regression tests: runs calculate on small inputs and compares its output with the expected one.
+# Build with ./compile.sh first. Prints every failing check and exits with the number of failures
+
+cd "$(dirname "$0")"
+calc=./calculate
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+failed=0
+printf 'x,y\n1,2\n2,8\n-1,3\n4,0\n' > $tmp/t.csv
+
+# check name expected actual
+check() {
+  if [ "$2" != "$3" ]; then
+    echo "FAIL $1"
+    echo "  expected: $(echo "$2" | tr '\n' '|')"
+    echo "  got:      $(echo "$3" | tr '\n' '|')"
+    failed=$((failed+1))
+  fi
+}
+
+# batch name input expected, input lines are separated by ;
+batch() {
+  check "$1" "$3" "$(echo "$2" | tr ';' '\n' | $calc --batch 2>&1)"
+}
+
+### solve() and integrate()
+batch "solve" "solve(x^2-2,x,0,2);solve(x-1,x,2,3)" "$(printf '1.414213562373095\nMath error: expression does not change its sign in the given interval')"
+batch "integrate" "integrate(x^2,x,0,3);integrate(sin(x),x,0,pi)" "$(printf '9\n2')"
+check "integrate cancelling" "yes" "$(echo 'integrate(1000*sin(100x),x,0,2pi)' | $calc --batch | awk '{ print ($1 < 1e-9 && $1 > -1e-9) ? "yes" : $0 }')"
+
+### library files: load what was compiled, reject corrupt entries
+echo '1+x;2*x' | tr ';' '\n' | $calc --compile $tmp/lib --variables x
+check "library" "$(printf '3\n4')" "$(echo 2 | $calc --load $tmp/lib 2>&1)"
+cp $tmp/lib $tmp/depth
+printf '\xf0\xff\xff\xff' | dd of=$tmp/depth bs=1 seek=44 conv=notrunc 2>/dev/null #depth of entry 0
+check "library depth" "$tmp/depth: corrupt expression entry" "$(echo 2 | $calc --load $tmp/depth 2>&1)"
+printf '\x00\x00\x00\x00' | dd of=$tmp/depth bs=1 seek=44 conv=notrunc 2>/dev/null
+check "library depth 0" "$tmp/depth: corrupt expression entry" "$(echo 2 | $calc --load $tmp/depth 2>&1)"
+head -c 40 $tmp/lib > $tmp/truncated
+check "library truncated" "$tmp/truncated: truncated file" "$(echo 2 | $calc --load $tmp/truncated 2>&1)"
+
+### aggregate and histogram: exact sums, errors by state, infinite results
+check "aggregate" "$(printf 'count 3\nsum 0.6\nmean 0.19999999999999998\nmin 0.1\nmax 0.3\nnan 0\nerrors 1\nmatherror 1')" \
+  "$(printf '0.1\n0.2\n0.3\n1/0\n' | $calc --aggregate)"
+check "aggregate infinite" "$(printf 'count 3\nsum -inf\nmean -inf')" "$(printf '1\n-(10^400)\n2\n' | $calc --aggregate | head -3)"
+check "histogram" "$(printf 'below 1\nbin 0 5 2\nbin 5 10 1\nabove 1')" "$(printf '%s\n' -1 0 4.9 5 10 | $calc --histogram 0,10,2 | tail -4)"
+
+### statistics: compiled evaluations are counted, counts of finished threads survive
+check "stats table" '"points":4' "$($calc --table $tmp/t.csv --expression 'x*y' --stats 2>&1 >/dev/null | grep -o '"points":[0-9]*')"
+check "stats aggregate" '"expressions":3' "$(printf '1\n2\n3\n' | $calc --aggregate --stats 2>&1 >/dev/null | grep -o '"expressions":[0-9]*')"
+
+### comparisons share one precedence and group left to right
+batch "comparisons" "1<2>0.5;(1<2)>0.5;2==2>1;1+1==2" "$(printf '1\n1\n0\n1')"
+
+### if(c,a,b): errors inside a branch only count if it is taken
+check "if table" "$(printf '2\n4\nMath error\n0')" "$($calc --table $tmp/t.csv --expression 'if(x>0,y/x,1/0)' 2>&1)"
+printf 'if(x>0,y/x,1/0)\nif(x>0,1,(1/0)+2*3)\n' | $calc --compile $tmp/if.lib --variables x,y
+check "if library" "$(printf '2\n1\nMath error\nMath error')" "$(printf '2 4\n-1 1\n' | $calc --load $tmp/if.lib 2>&1)"
+batch "if solve" "solve(if(x>0,x-1,1/0),x,0.5,3);integrate(if(x>=0,x,1/0),x,0,1);bound(if(x>0,x,1/0),x,1,2)" "$(printf '1\n0.5\n[1, 2]')"
+batch "if parse" "if(1>0,2,1/0);if(0,2,1/0)" "$(printf '2\nMath error: Division by zero')"
+printf 'x\n0\n1\n2\n' > $tmp/x.csv
+check "and/or table" "$(printf '0\n1\n0\n1\n1\n0')" "$($calc --table $tmp/x.csv --expression 'x>0 and 1/x>0.7' 2>&1; $calc --table $tmp/x.csv --expression 'x<=0 or 1/x>0.7' 2>&1)"
+printf 'x>0 and 1/x>0.7\nx<=0 or 1/x>0.7\n' | $calc --compile $tmp/andor.lib --variables x
+check "and/or library" "$(printf '0\n1\n1\n1\n0\n0')" "$(printf '0\n1\n2\n' | $calc --load $tmp/andor.lib 2>&1)"
+check "if unclosed" "$(printf 'Syntax error: Missing right parenthese of if\nline 1: Syntax error: Missing right parenthese of if')" \
+  "$($calc --table $tmp/t.csv --expression 'if(x>0,x,5' 2>&1; echo 'if(x>0,x,5' | $calc --compile $tmp/unclosed.lib --variables x 2>&1)"
+
+### binary records: 16 bytes each, little-endian double, status byte, zero padding
+check "binary records" "$(printf ' 00 00 00 00 00 00 08 40 01 00 00 00 00 00 00 00\n 00 00 00 00 00 00 f8 7f 03 00 00 00 00 00 00 00')" \
+  "$(printf '1+2\n1/0\n' | $calc --binary | od -An -tx1 -v -w16)"
+check "binary bound" "$(printf ' 00 00 00 00 00 00 f8 7f 01 01 00 00 02 00 00 00\n 00 00 00 00 00 00 00 00 01 00 00 00 00 00 00 00\n 00 00 00 00 00 00 f0 3f 01 00 00 00 00 00 00 00\n 00 00 00 00 00 00 f8 7f 03 01 00 00 00 00 00 00')" \
+  "$(printf 'bound(x,x,0,1)\nbound(1/0+x,x,0,1)\n' | $calc --binary | od -An -tx1 -v -w16)"
+check "binary vector" "$(printf ' 00 00 00 00 00 00 f8 7f 01 02 00 00 02 00 00 00\n 00 00 00 00 00 00 f0 3f 01 00 00 00 00 00 00 00\n 00 00 00 00 00 00 00 40 01 00 00 00 00 00 00 00\n 00 00 00 00 00 00 f8 7f 01 02 00 00 00 00 00 00')" \
+  "$(printf '[1,2]\n[]\n' | $calc --binary | od -An -tx1 -v -w16)"
+### bound(): enclosures of the range, rounded outward. x-x is not recognized as 0, 1/x around 0 is unbounded
+batch "bound" "bound(x^2,x,-1,2);bound(x-x,x,0,1);bound(1/x,x,-1,1)" "$(printf '[0, 4.000000000000002]\n[-1.0000000000000002, 1.0000000000000002]\n[-inf, inf]')"
+batch "bound dependent ranges" "bound(y,x,1,2,y,-x,x^2);bound(x*y,x,0,1,y,0,x);bound(x,x,0,sqrt(-1));bound(y,x,0,1,y,0,z)" \
+  "$(printf '[-2, 4.000000000000002]\n[-5e-324, 1.0000000000000002]\nMath error: range of x is undefined\nSyntax error: unable to parse z')"
+
+### shm: a producer sends an expression, a library entry and a request with a bad length, then shuts the channel down
+cat > $tmp/producer.cpp <<'END'
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include "channel.h"
+
+int main(int argc, char **argv) {
+  channel ch;
+  for(int n = 0; n < 50 && !ch.attach(argv[1]); n++)
+    usleep(20000);
+  channel::request r;
+  memset(&r,0,sizeof(r));
+  r.tag = 1; r.kind = channel::expression; r.length = 3; memcpy(r.expression,"1+2",3);
+  ch.send(r);
+  r.tag = 2; r.kind = channel::entry; r.id = 0; r.length = 1; r.variables[0] = 2;
+  ch.send(r);
+  r.tag = 3; r.kind = channel::expression; r.length = 1000;
+  ch.send(r);
+  channel::response a;
+  for(int n = 0; n < 3 && ch.receive(a); n++)
+    cout << a.tag << " " << a.state << " " << a.value << endl;
+  ch.shutdown();
+  return 0;
+}
+END
+if g++ -O2 -I. -o $tmp/producer $tmp/producer.cpp channel.o deadline.o -lrt -pthread; then
+  $calc --shm /calculate-test-$$ --load $tmp/lib & pid=$!
+  check "shm requests" "$(printf '1 1 3\n2 1 3\n3 2 nan')" "$($tmp/producer /calculate-test-$$)"
+  wait $pid
+  check "shm shutdown" "0 yes" "$? $([ -e /dev/shm/calculate-test-$$ ] || echo yes)"
+else
+  check "shm producer builds" "" "no"
+fi
+
+### table: CSV with named columns, raw columnar doubles with --variables
+check "table csv" "$(printf '2\n16\n-3\n0')" "$($calc --table $tmp/t.csv --expression 'x*y' 2>&1)"
+printf '\x00\x00\x00\x00\x00\x00\xf0\x3f\x00\x00\x00\x00\x00\x00\x00\x40\x00\x00\x00\x00\x00\x00\x08\x40\x00\x00\x00\x00\x00\x00\x10\x40' > $tmp/t.bin #x 1 2, y 3 4
+check "table binary" "$(printf '4\n6')" "$($calc --table $tmp/t.bin --variables x,y --expression 'x+y' 2>&1)"
+printf 'e,x\n2,3\n' > $tmp/e.csv; printf 'max,x\n2,3\n' > $tmp/max.csv; printf 'a b,x\n2,3\n' > $tmp/ab.csv; printf ' a ,x\n2,3\n' > $tmp/blank.csv
+check "table names" "$(printf 'column name "e" is an operator, function or constant\ncolumn name "max" is an operator, function or constant\ncolumn name "a b" may only contain letters, digits and _\n4')" \
+  "$(for f in e max ab blank; do $calc --table $tmp/$f.csv --expression 'a*2' 2>&1; done)"
+batch "variable names" "bound(e,e,0,1);solve(max-1,max,0,2)" "$(printf 'Syntax error: variable name "e" is an operator, function or constant\nSyntax error: variable name "max" is an operator, function or constant')"
+
+### watch: saving the file prints a diff of the changed lines, lines using a changed ans are evaluated again
+printf '1+1\nans*2\n5\n' > $tmp/watched
+$calc --watch $tmp/watched > $tmp/watch.out 2>&1 & pid=$!
+sleep 0.3
+printf '2+1\nans*2\n5\n' > $tmp/watched
+sleep 0.3
+kill -INT $pid; wait $pid
+check "watch" "$(printf '1+1 = 2\nans*2 = 4\n5 = 5\n%s: evaluated 3 of 3 lines\n@@ line 1 @@\n-1+1 = 2\n-ans*2 = 4\n+2+1 = 3\n+ans*2 = 6\n%s: evaluated 2 of 3 lines' $tmp/watched $tmp/watched)" "$(cat $tmp/watch.out)"
+
+### stream: input is fed in chunks of 64KiB, blanks pad tokens so they cross the chunk boundary at every position
+# split expression: evaluates expression with the chunk boundary 1 to 4 characters into it
+split() {
+  for n in 1 2 3 4; do
+    { printf "%$((65536-n))s" ''; echo "$1"; } | $calc --stream 2>&1
+  done | uniq
+}
+check "stream split number" "1500" "$(split '1.5E3+0')"
+check "stream split exponent" "0.0015" "$(split '1.5E-3')"
+check "stream split function" "2" "$(split 'sin(0)+2')"
+check "stream split name" "3.141592653589793" "$(split 'arctan(1)*4')"
+check "stream long sum" "5000050000" "$(seq 1 100000 | paste -sd+ | $calc --stream 2>&1)"
+check "stream deep nesting" "1" "$({ printf '%.0s(' $(seq 100000); printf 1; printf '%.0s)' $(seq 100000); } | $calc --stream 2>&1)"
+check "stream late error" "Syntax error: Missing left parenthese" "$({ seq 1 100000 | paste -sd+ | tr -d '\n'; echo '+2)'; } | $calc --stream 2>&1)"
+
+### time limits: a line, an integration or a table running too long is given up with one message, the next line still runs
+check "timeout parse" "$(printf 'Time limit exceeded\n5')" "$({ seq 1 2000000 | paste -sd+; echo 2+3; } | $calc --batch --timeout 20 2>&1)"
+check "timeout integrate" "$(printf 'Time limit exceeded\n5')" \
+  "$(printf 'integrate(sin(1000x)*(%s),x,0,100)\n2+3\n' "$(printf 'sin(x)+%.0s' $(seq 299))sin(x)" | $calc --batch --timeout 50 2>&1)"
+{ echo x; seq 1 2000000; } > $tmp/rows.csv
+check "timeout table" "Time limit exceeded after" "$($calc --table $tmp/rows.csv --expression 'sin(x)^2+cos(x)^2' --timeout 5 2>&1 >/dev/null | grep -o 'Time limit exceeded after')"
+
+### cancellation: the first Ctrl-C ends modes waiting for input, an idle shm server removes its segment
+# stopped pid: whether pid ended within a second after SIGINT
+stopped() {
+  kill -INT $1
+  for n in 1 2 3 4 5 6 7 8 9 10; do
+    kill -0 $1 2>/dev/null || { wait $1; echo yes; return; }
+    sleep 0.1
+  done
+  kill -9 $1
+  echo no
+}
+shm=/calculate-test-$$
+$calc --shm $shm & pid=$!
+sleep 0.3
+check "shm created" "yes" "$([ -e /dev/shm$shm ] && echo yes)"
+check "shm cancelled" "yes" "$(stopped $pid)"
+check "shm removed" "yes" "$([ -e /dev/shm$shm ] || echo yes)"
+{ echo 1+1; sleep 2; } | $calc --batch > $tmp/cancel & pid=$!
+sleep 0.3
+check "batch cancelled" "yes" "$(stopped $pid)"
+check "batch cancelled output" "2" "$(cat $tmp/cancel)"
+{ echo 1+1; sleep 2; } | $calc --aggregate > /dev/null & pid=$!
+sleep 0.3
+check "aggregate cancelled" "yes" "$(stopped $pid)"
+
+[ $failed -eq 0 ] && echo "all tests passed"
+exit $failed
@@ -0,0 +1,257 @@
+/***********************************************************/
+/*               value class implementation                */
+/***********************************************************/
+
+#include "value.h"
+#include "parser.h"
+
+#include <cmath>
+#include <limits>
+
+#ifdef M_PI
+  const double LPI = M_PI;
+#else
+  const double LPI = 3.14159;
+#endif
+
+//Element-wise kernels. a and b either hold n elements (step 1) or a single broadcast scalar (step 0). Every instantiation is a plain loop over
+//contiguous memory, which the compiler turns into SIMD code (compile.sh passes -fopenmp-simd to honor the pragmas)
+template<int aStep, int bStep>
+static void operationKernel(unsigned int op, const double *a, const double *b, double *r, size_t n) {
+  switch( op ) {
+    case operators::plus   :
+                             #pragma omp simd
+                             for(size_t i = 0; i < n; i++)
+                               r[i] = a[i*aStep]+b[i*bStep];
+                             break;
+    case operators::minus  :
+                             #pragma omp simd
+                             for(size_t i = 0; i < n; i++)
+                               r[i] = a[i*aStep]-b[i*bStep];
+                             break;
+    case operators::times  :
+                             #pragma omp simd
+                             for(size_t i = 0; i < n; i++)
+                               r[i] = a[i*aStep]*b[i*bStep];
+                             break;
+    case operators::divide :
+                             #pragma omp simd
+                             for(size_t i = 0; i < n; i++)
+                               r[i] = a[i*aStep]/b[i*bStep];
+                             break;
+    default                : for(size_t i = 0; i < n; i++)
+                               r[i] = value::operation(op,a[i*aStep],b[i*bStep]);
+  }
+}
+
+static void functionKernel(unsigned int op, const double *a, double *r, size_t n) {
+  switch( op ) {
+    case operators::negation :
+                               #pragma omp simd
+                               for(size_t i = 0; i < n; i++)
+                                 r[i] = -a[i];
+                               break;
+    case operators::abs      :
+                               #pragma omp simd
+                               for(size_t i = 0; i < n; i++)
+                                 r[i] = fabs(a[i]);
+                               break;
+    case operators::sqrt     :
+                               #pragma omp simd
+                               for(size_t i = 0; i < n; i++)
+                                 r[i] = sqrt(a[i]);
+                               break;
+    default                  : //sin, cos, ... (and pow() above) stay scalar libm calls: glibc only vectorizes them with -ffast-math,
+                               //whose less accurate results would change the printed digits
+                               for(size_t i = 0; i < n; i++)
+                                 r[i] = value::function(op,a[i]);
+  }
+}
+
+value::value() : p_scalar(0), p_vector(false) {
+}
+
+value::value(double scalar) : p_scalar(scalar), p_vector(false) {
+}
+
+value::value(const vector<double>& elements) : p_scalar(numeric_limits<double>::quiet_NaN()), p_elements(elements), p_vector(true) {
+}
+
+bool value::isVector() const {
+  return p_vector;
+}
+
+size_t value::size() const {
+  return p_vector ? p_elements.size() : 1;
+}
+
+double value::scalar() const {
+  return p_scalar;
+}
+
+const vector<double>& value::elements() const {
+  return p_elements;
+}
+
+bool value::containsZero() const {
+  if( !p_vector )
+    return p_scalar == 0;
+  for(vector<double>::const_iterator it = p_elements.begin(); it != p_elements.end(); it++)
+    if( *it == 0 )
+      return true;
+  return false;
+}
+
+bool value::truth(double v) {
+  return v != 0 && v == v;
+}
+
+double value::operation(unsigned int op, double a, double b) {
+  switch( op ) {
+    case operators::plus         : return a+b;
+    case operators::minus        : return a-b;
+    case operators::times        : return a*b;
+    case operators::divide       : return a/b;
+    case operators::pow          : return pow(a,b);
+    case operators::equal        : return a == b;
+    case operators::notEqual     : return a != b;
+    case operators::less         : return a < b;
+    case operators::lessEqual    : return a <= b;
+    case operators::greater      : return a > b;
+    case operators::greaterEqual : return a >= b;
+    case operators::logicalAnd   : return truth(a) && truth(b);
+    case operators::logicalOr    : return truth(a) || truth(b);
+  }
+  return numeric_limits<double>::quiet_NaN();
+}
+
+//sin, cos and tan round results that only differ from 0 (or infinity for tan) by rounding errors of pi
+double value::function(unsigned int op, double v) {
+  double r;
+  switch( op ) {
+    case operators::negation : return -v;
+    case operators::sin      : r = sin(v);
+                               if( fabs(r) < numeric_limits<double>::epsilon()*(2*v/LPI) ) //workaround for sin(n*pi) != 0
+                                 r = 0;
+                               return r;
+    case operators::cos      : r = cos(v);
+                               if( fabs(r) < numeric_limits<double>::epsilon()*(2*v/LPI) )
+                                 r = 0;
+                               return r;
+    case operators::tan      : r = tan(v);
+                               if( fabs(r) < numeric_limits<double>::epsilon()*(2*v/LPI) )
+                                 r = 0;
+                               if( 1/fabs(r) < numeric_limits<double>::epsilon()*(2*v/LPI) )
+                                 r = numeric_limits<double>::infinity();
+                               return r;
+    case operators::arcsin   : return asin(v); //no need to check domain, c++ does that for us, e.g. asin(2) returns "nan"
+    case operators::arccos   : return acos(v);
+    case operators::arctan   : return atan(v);
+    case operators::sqrt     : return sqrt(v);
+    case operators::abs      : return fabs(v);
+    case operators::sum      :
+    case operators::mean     :
+    case operators::min      :
+    case operators::max      : return v;
+  }
+  return numeric_limits<double>::quiet_NaN();
+}
+
+//binary operators and dot
+bool value::combine(unsigned int op, const value& a, const value& b, value& result) {
+  if( a.p_vector && b.p_vector && a.p_elements.size() != b.p_elements.size() )
+    return false;
+  if( op == operators::dot ) {
+    if( a.p_vector && b.p_vector )
+      result = value(dot(a.p_elements.data(),b.p_elements.data(),a.p_elements.size()));
+    else if( a.p_vector )
+      result = value(sum(a.p_elements.data(),a.p_elements.size())*b.p_scalar);
+    else if( b.p_vector )
+      result = value(a.p_scalar*sum(b.p_elements.data(),b.p_elements.size()));
+    else
+      result = value(a.p_scalar*b.p_scalar);
+    return true;
+  }
+  if( !a.p_vector && !b.p_vector ) {
+    result = value(operation(op,a.p_scalar,b.p_scalar));
+    return true;
+  }
+  result = value(vector<double>(a.p_vector ? a.p_elements.size() : b.p_elements.size()));
+  double *r = result.p_elements.data();
+  if( a.p_vector && b.p_vector )
+    operationKernel<1,1>(op,a.p_elements.data(),b.p_elements.data(),r,result.p_elements.size());
+  else if( a.p_vector )
+    operationKernel<1,0>(op,a.p_elements.data(),&b.p_scalar,r,result.p_elements.size());
+  else
+    operationKernel<0,1>(op,&a.p_scalar,b.p_elements.data(),r,result.p_elements.size());
+  return true;
+}
+
+//negation, functions and reductions
+value value::apply(unsigned int op, const value& a) {
+  if( !a.p_vector )
+    return value(function(op,a.p_scalar));
+  const double *x = a.p_elements.data();
+  size_t n = a.p_elements.size();
+  switch( op ) {
+    case operators::sum  : return value(sum(x,n));
+    case operators::mean : return value(n ? sum(x,n)/n : numeric_limits<double>::quiet_NaN());
+    case operators::min  :
+    case operators::max  : {
+                             double r = n ? x[0] : numeric_limits<double>::quiet_NaN();
+                             for(size_t i = 1; i < n; i++)
+                               r = op == operators::min ? fmin(r,x[i]) : fmax(r,x[i]);
+                             return value(r);
+                           }
+  }
+  value result = value(vector<double>(n));
+  if( n )
+    functionKernel(op,x,result.p_elements.data(),n);
+  return result;
+}
+
+//pick a or b by c. Vector conditions pick element by element, so all three have to be of the same size or scalar
+bool value::select(const value& c, const value& a, const value& b, value& result) {
+  if( !c.p_vector ) {
+    result = truth(c.p_scalar) ? a : b;
+    return true;
+  }
+  size_t n = c.p_elements.size();
+  if( (a.p_vector && a.p_elements.size() != n) || (b.p_vector && b.p_elements.size() != n) )
+    return false;
+  result = value(vector<double>(n));
+  for(size_t i = 0; i < n; i++)
+    result.p_elements[i] = truth(c.p_elements[i]) ? (a.p_vector ? a.p_elements[i] : a.p_scalar) : (b.p_vector ? b.p_elements[i] : b.p_scalar);
+  return true;
+}
+
+//pairwise summation: error grows with log(n) instead of n, the 8 independent partial sums of the base case vectorize
+double value::sum(const double *x, size_t n) {
+  if( n > 256 ) {
+    size_t half = n/16*8;
+    return sum(x,half)+sum(x+half,n-half);
+  }
+  double partial[8] = { 0, 0, 0, 0, 0, 0, 0, 0 }, rest = 0;
+  size_t i = 0;
+  for(; i+8 <= n; i += 8)
+    for(int j = 0; j < 8; j++)
+      partial[j] += x[i+j];
+  for(; i < n; i++)
+    rest += x[i];
+  return ((partial[0]+partial[1])+(partial[2]+partial[3]))+((partial[4]+partial[5])+(partial[6]+partial[7]))+rest;
+}
+
+double value::dot(const double *a, const double *b, size_t n) {
+  if( n > 256 ) {
+    size_t half = n/16*8;
+    return dot(a,b,half)+dot(a+half,b+half,n-half);
+  }
+  double partial[8] = { 0, 0, 0, 0, 0, 0, 0, 0 }, rest = 0;
+  size_t i = 0;
+  for(; i+8 <= n; i += 8)
+    for(int j = 0; j < 8; j++)
+      partial[j] += a[i+j]*b[i+j];
+  for(; i < n; i++)
+    rest += a[i]*b[i];
+  return ((partial[0]+partial[1])+(partial[2]+partial[3]))+((partial[4]+partial[5])+(partial[6]+partial[7]))+rest;
+}
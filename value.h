@@ -0,0 +1,46 @@
+/***********************************************************/
+/*                     value class                         */
+/* A number on the parser's stack: either a scalar or a    */
+/* vector. Operators and functions work element-wise on    */
+/* vectors, scalars are broadcast to the other operand's   */
+/* size. Reductions (sum, mean, min, max, dot) turn        */
+/* vectors into scalars, comparisons give vectors of 1 and */
+/* 0 that if(c,a,b) selects from element by element.       */
+/***********************************************************/
+
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+class value {
+public:
+  value();
+  value(double scalar);
+  value(const vector<double>& elements);
+  bool isVector() const;
+  size_t size() const;
+  double scalar() const; //NaN for vectors
+  const vector<double>& elements() const;
+  bool containsZero() const;
+
+  static bool truth(double v);                                  //conditions hold for anything but 0 and NaN
+  static double operation(unsigned int op, double a, double b); //binary operators, comparisons and logical operators give 1 or 0
+  static double function(unsigned int op, double v);            //negation and functions, reductions of a scalar
+  static bool combine(unsigned int op, const value& a, const value& b, value& result); //false if vector sizes differ
+  static value apply(unsigned int op, const value& a);
+  static bool select(const value& c, const value& a, const value& b, value& result); //if(c,a,b), element-wise for vectors
+
+private:
+  static double sum(const double *x, size_t n);
+  static double dot(const double *a, const double *b, size_t n);
+
+  double p_scalar;
+  vector<double> p_elements;
+  bool p_vector;
+};
+
+#endif //VALUE_H